@@ -11,8 +11,72 @@
 
 // Keys and values for messages from iOS to the Pebble
 
+// Key for messages from the Pebble to the phone
+#define PBCOMM_REQUEST_KEY                  0x01    // ask the phone for fresh data
+
+// Values for PBCOMM_REQUEST_KEY
+#define REQUEST_UPDATE                      0x01    // send whatever changed since the last update
+#define REQUEST_FULL_UPDATE                 0x02    // resend every field (watch lost track)
+
+// Number of zones configured on the phone, 1 to MAX_WATCH_FACES. Not tied to a watch.
+#define PBCOMM_ZONE_COUNT_KEY               0x08
+
+// Sent with PBCOMM_REQUEST_KEY, uint16. The phone echoes it in PBCOMM_TIMING_KEY with its reply.
+#define PBCOMM_REQUEST_ID_KEY               0x0A
+
+// Whether to run the background worker while the app is closed, 0 or 1. The phone sends it
+// when the configuration is saved. Not tied to a watch.
+#define PBCOMM_WORKER_KEY                   0x0E
+
+// Where the phone's time went answering a request. Not tied to a watch.
+#define PBCOMM_TIMING_KEY                   0x0B
+
+// Offsets in PBCOMM_TIMING_KEY data, each a uint16 little-endian. Times are in ms, 0 if the
+// stage didn't run (e.g. every forecast came from the cache).
+#define TIMING_REQUEST_ID                   0       // PBCOMM_REQUEST_ID_KEY being answered
+#define TIMING_GEOLOCATION                  2       // finding the phone's position
+#define TIMING_HTTP                         4       // longest geocode or forecast request
+#define TIMING_PHONE                        6       // request arriving to reply being sent
+#define TIMING_LEN                          8
+
+// Events from the watch's log, oldest first, sent from the watch when asked to flush it.
+// Not tied to a watch.
+#define PBCOMM_LOG_KEY                      0x0C
+
+// Offsets in each PBCOMM_LOG_KEY record, multi-byte values little-endian
+#define LOG_TIME                            0       // 4 bytes, uint32 UTC seconds
+#define LOG_EVENT                           4       // 1 byte, EVENT_*
+#define LOG_LEVEL                           5       // 1 byte, EVENT_LEVEL_*
+#define LOG_ARG_A                           6       // 2 bytes, int16, see the event
+#define LOG_ARG_B                           8       // 4 bytes, int32, see the event
+#define LOG_RECORD_LEN                      12
+
+// Values for LOG_LEVEL
+#define EVENT_LEVEL_ERROR                   1
+#define EVENT_LEVEL_WARNING                 2
+#define EVENT_LEVEL_INFO                    3
+#define EVENT_LEVEL_DEBUG                   4
+
+// Values for LOG_EVENT. Where B is listed as bytes, the first is the least significant.
+#define EVENT_INBOX_DROPPED                 0x01    // A: AppMessageResult
+#define EVENT_OUTBOX_FAILED                 0x02    // A: AppMessageResult, B: request pending
+#define EVENT_BAD_UPDATE_HEADER             0x03    // A: watch, B: length
+#define EVENT_TRUNCATED_UPDATE              0x04    // A: watch, B: length, then fields << 16
+#define EVENT_BAD_CURRENT_WINDOW            0x05    // A: current_window, B: button (0 up, 1 down)
+#define EVENT_REQUEST_SENT                  0x06    // A: request ID, B: REQUEST_*
+#define EVENT_REQUEST_TIMEOUT               0x07    // A: request ID
+#define EVENT_NO_MEMORY                     0x08    // A: bytes, B: what failed (0 view, 1 window, 2 layer)
+#define EVENT_DUMP                          0x10    // A: zone count, B: main window page
+#define EVENT_ZONE_OFFSET                   0x11    // A: watch, B: GMT offset
+#define EVENT_ZONE_STYLE                    0x12    // A: watch, B bytes: background, display, time style
+#define EVENT_ZONE_HIGHS                    0x13    // A: watch, B bytes: current, three highs
+#define EVENT_ZONE_LOWS                     0x14    // A: watch, B bytes: three lows
+#define EVENT_ZONE_SUNS                     0x15    // A: watch, B bytes: sunrise h/m, sunset h/m
+#define EVENT_LATENCY                       0x16    // A: request timeouts, B: first bucket's limit in ms
+#define EVENT_LATENCY_BUCKETS               0x17    // A: stage << 8 | bucket, B: its count, then the next's << 16
+
 // Factors, the keys are actually grouped by 16, depending on the watch to update
-// Add these to the KEYs to get the actual value
+// Add these to the KEYs to get the actual value: zone n uses n * KEYS_PER_WATCH + key
 #define LOCAL_WATCH_OFFSET                  0x00
 #define TZ1_WATCH_OFFSET                    0x10
 #define TZ2_WATCH_OFFSET                    0x20
@@ -23,6 +87,9 @@
 #define PBCOMM_BACKGROUND_KEY               0x04    // light, dark or Sunrise/Sunset (AM/PM) background
 #define PBCOMM_12_24_DISPLAY_KEY            0x05    // display in watch-configured-, 12- or 24-hour time
 #define PBCOMM_WEATHER_KEY                  0x06    // weather conditions icon, temps, suns times
+#define PBCOMM_UPDATE_KEY                   0x07    // v2 update, only the fields that changed
+#define PBCOMM_TRANSITIONS_KEY              0x09    // upcoming GMT offset changes, e.g. DST
+#define PBCOMM_LOCATION_KEY                 0x0D    // latitude/longitude, for sunrise/sunset
 #define KEYS_PER_WATCH                      0x10    // maximum number of keys/watch
 
 // Values for PBCOMMM_BACKGROUND_KEY
@@ -48,6 +115,43 @@
 #define SUNSET_MINUTE                       13      // Sunset minute (today, used for background)
 #define WEATHER_KEY_LEN                     14      // Number of bytes in PBCOMM_WEATHER_KEY data
 
+// Offsets in PBCOMM_UPDATE_KEY data. A three byte header is followed by each field flagged
+// in UPDATE_FIELDS, in bit order, using the same layout as the v1 key it replaces.
+#define UPDATE_VERSION                      0       // Protocol version, UPDATE_PROTOCOL_V2
+#define UPDATE_SEQUENCE                     1       // Per-watch sequence number, wraps at 256
+#define UPDATE_FIELDS                       2       // Field presence bitmap, UPDATE_HAS_*
+#define UPDATE_HEADER_LEN                   3       // Number of bytes before the first field
+#define UPDATE_PROTOCOL_V2                  0x02
+
+// Values for UPDATE_FIELDS
+#define UPDATE_HAS_OFFSET                   0x01    // 4 bytes, int32 GMT offset, little-endian
+#define UPDATE_HAS_BACKGROUND               0x02    // 1 byte, BACKGROUND_*
+#define UPDATE_HAS_DISPLAY                  0x04    // 1 byte, DISPLAY_*
+#define UPDATE_HAS_ICONS                    0x08    // 3 bytes, as WEATHER_ICONS
+#define UPDATE_HAS_TEMPS                    0x10    // 7 bytes, as CURRENT_TEMP through MIN_TEMPS
+#define UPDATE_HAS_SUNS                     0x20    // 4 bytes, as SUNRISE_HOUR through SUNSET_MINUTE
+                                                    // (no longer sent, see PBCOMM_LOCATION_KEY)
+#define UPDATE_HAS_CITY                     0x40    // 1 byte length, then the city without a NUL
+#define UPDATE_FULL                         0x80    // Every field sent is present, ignore the sequence
+
+#define UPDATE_ICONS_LEN                    3
+#define UPDATE_TEMPS_LEN                    7
+#define UPDATE_SUNS_LEN                     4
+#define MAX_CITY_LEN                        32      // Including the terminating NUL
+
+// Offsets in each PBCOMM_TRANSITIONS_KEY entry. The data is up to MAX_TRANSITIONS entries,
+// earliest first, each giving the zone's GMT offset from that instant on. A zone with none
+// is sent as a single 0 byte, which clears the table.
+#define TRANSITION_TIME                     0       // 4 bytes, uint32 UTC seconds, little-endian
+#define TRANSITION_OFFSET                   4       // 1 byte, int8 GMT offset in quarter hours
+#define TRANSITION_LEN                      5
+#define MAX_TRANSITIONS                     4
+
+// Offsets in PBCOMM_LOCATION_KEY data. The watch works out sunrise and sunset from these.
+#define LOCATION_LATITUDE                   0       // 2 bytes, int16 hundredths of a degree, north positive
+#define LOCATION_LONGITUDE                  2       // 2 bytes, int16 hundredths of a degree, east positive
+#define LOCATION_LEN                        4
+
 // Values for PBCOMM_WEATHER_KEY
 // Map directly to forecast.io weather icon values
 #define WEATHER_UNKNOWN                     0x00
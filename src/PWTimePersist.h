@@ -0,0 +1,50 @@
+//
+//  PWTimePersist.h
+//  PebbleWorldTime
+//
+//  Persistent storage layout, shared by the app and its background worker
+//
+
+#ifndef PebbleWorldTime_PWTimePersist_h
+#define PebbleWorldTime_PWTimePersist_h
+
+#include "PWTimeKeys.h"
+
+// Persistent storage keys
+#define PERSIST_VERSION_KEY     0x00
+#define PERSIST_ZONE_COUNT_KEY  0x01
+#define PERSIST_WORKER_KEY      0x02        // 1 if the user turned the background worker on
+#define PERSIST_ZONE_KEY        0x10        // + watch number
+#define PERSIST_VERSION         4           // Bump when PersistedZone changes
+
+#define DEFAULT_WATCH_FACES     3           // Zones shown until the phone says otherwise
+
+// Last known state of a watchface, restored at launch so the first frame is already right
+typedef struct {
+    int32_t      gmt_sec_offset;
+    uint32_t     last_weather_update;
+    uint8_t      background;
+    uint8_t      display;
+    uint8_t      weather[WEATHER_KEY_LEN];  // Same layout as PBCOMM_WEATHER_KEY data
+    char         city[MAX_CITY_LEN];
+    uint8_t      transition_count;
+    uint8_t      transitions[MAX_TRANSITIONS * TRANSITION_LEN];
+    uint8_t      days_rolled;               // forecast days dropped since last_weather_update
+    uint8_t      has_location;
+    uint8_t      location[LOCATION_LEN];    // Same layout as PBCOMM_LOCATION_KEY data
+} PersistedZone;
+
+// UTC time of a PBCOMM_TRANSITIONS_KEY entry
+static inline time_t transition_time(const uint8_t *entry) {
+    return (time_t)((uint32_t)entry[TRANSITION_TIME]           |
+                    ((uint32_t)entry[TRANSITION_TIME+1] << 8)  |
+                    ((uint32_t)entry[TRANSITION_TIME+2] << 16) |
+                    ((uint32_t)entry[TRANSITION_TIME+3] << 24));
+}
+
+// GMT offset, in seconds, from a PBCOMM_TRANSITIONS_KEY entry on
+static inline int32_t transition_offset(const uint8_t *entry) {
+    return (int32_t)(int8_t)entry[TRANSITION_OFFSET] * 15 * 60;
+}
+
+#endif
@@ -8,10 +8,120 @@ var getlocationOptions = {
 //                              "maximumAge": 1800000
 //                            };
 
-var pbl_msg_queue = [];
 var appData = {};
 var fioKeyString = "fioKey";
 
+// Mirrors PWTimeKeys.h
+var REQUEST_FULL_UPDATE   = 0x02;
+var PBCOMM_CITY_KEY       = 0x03;
+var PBCOMM_UPDATE_KEY     = 0x07;
+var PBCOMM_ZONE_COUNT_KEY = 0x08;
+var PBCOMM_TRANSITIONS_KEY = 0x09;
+var PBCOMM_LOCATION_KEY   = 0x0D;
+var PBCOMM_WORKER_KEY     = 0x0E;
+var PBCOMM_TIMING_KEY     = 0x0B;
+var LOG_RECORD_LEN        = 12;
+var EVENT_LEVELS          = [ "", "E", "W", "I", "D" ];
+var EVENT_FORMATS         = {   // event -> how to show its A and B arguments
+    0x01 : [ "inbox dropped",      "reason" ],
+    0x02 : [ "outbox failed",      "reason",  "request" ],
+    0x03 : [ "bad update header",  "watch",   "length" ],
+    0x04 : [ "truncated update",   "watch",   function (b) {
+                 return "length: " + (b & 0xFFFF) + ", fields: 0x" + (b >>> 16).toString(16);
+             } ],
+    0x05 : [ "bad current_window", "window",  "down" ],
+    0x06 : [ "request sent",       "id",      "request" ],
+    0x07 : [ "request timed out",  "id" ],
+    0x08 : [ "out of memory",      "bytes",   "what" ],
+    0x10 : [ "dump",               "zones",   "page" ],
+    0x11 : [ "zone offset",        "watch",   "offset" ],
+    0x12 : [ "zone style",         "watch",   "background/display/style" ],
+    0x13 : [ "zone highs",         "watch",   "temp/hi0/hi1/hi2" ],
+    0x14 : [ "zone lows",          "watch",   "lo0/lo1/lo2" ],
+    0x15 : [ "zone suns",          "watch",   "rise h/m/set h/m" ],
+    0x16 : [ "request latency",    "timeouts", "first bucket ms" ],
+    0x17 : [ "latency",            function (a) {
+                 return (LATENCY_STAGES[a >> 8] || "stage " + (a >> 8)) + ", buckets " +
+                        (a & 0xFF) + "-" + ((a & 0xFF) + 1);
+             }, function (b) {
+                 return "counts: " + (b & 0xFFFF) + "/" + (b >>> 16);
+             } ]
+};
+var LATENCY_STAGES        = [ "bt out", "geolocation", "http", "bt back" ];
+var KEYS_PER_WATCH        = 0x10;
+var UPDATE_PROTOCOL_V2    = 0x02;
+var UPDATE_HAS_OFFSET     = 0x01;
+var UPDATE_HAS_BACKGROUND = 0x02;
+var UPDATE_HAS_DISPLAY    = 0x04;
+var UPDATE_HAS_ICONS      = 0x08;
+var UPDATE_HAS_TEMPS      = 0x10;
+var UPDATE_HAS_CITY       = 0x40;
+var UPDATE_FULL           = 0x80;
+var WEATHER_ICONS         = 0;
+var CURRENT_TEMP          = 3;
+var MAX_CITY_LEN          = 32;
+var MAX_TRANSITIONS       = 4;
+var MAX_ZONES             = 8;  // MAX_WATCH_FACES on the watch
+
+var DEFAULT_ZONES = [
+    { "latitude" :  0,         "longitude" :   0,        "city" : "Local"           },
+    { "latitude" : 51.507200,  "longitude" :   0.127500, "city" : "London, England" },
+    { "latitude" : 35.689500,  "longitude" : 139.691700, "city" : "Tokyo, Japan"    }
+];
+var zoneCountString = "zoneCount";
+
+var zoneSent     = [];          // last zone state sent to the watch, missing means send everything
+var zoneSequence = [];          // v2 sequence number of the last update sent for each zone
+var zoneCountSent;              // zone count last sent to the watch
+var transitionsSent = [];       // transition table last sent for each zone, as a string
+var locationSent    = [];       // location last sent for each zone, as a string
+
+var MINUTE_MS = 60000;
+var DAY_MS = 86400000;
+var TRANSITION_SCAN_DAYS = 400; // how far ahead to look for GMT offset changes
+var transitionCache = {};       // IANA zone -> { "until" : ms, "transitions" : [...] }
+
+var FORECAST_EXCLUDE = "minutely,hourly,alerts,flags";  // forecast.io blocks we never use
+var fetchStats = { "fetches" : 0, "bytes" : 0, "parseMs" : 0 };  // for the current refresh
+
+var CACHE_PREFIX  = "cache:";   // localStorage keys of cached geocode and forecast results
+var GEOCODE_TTL   = 30 * DAY_MS;
+var FORECAST_TTL  = 20 * MINUTE_MS;
+var cache = {
+    "inFlight" : {},            // key -> callbacks waiting on the request already made for it
+    "stats"    : {
+        "hits"   : 0,
+        "misses" : 0,
+        "shared" : 0            // lookups that joined a request already in flight
+    }
+};
+
+var BATCH_TIMEOUT = 30000;      // send whatever a batch has after this long (ms)
+var FRESH_INTERVAL = 1800000;   // the watch keeps data this long, no refresh needed at launch (ms)
+var lastRefreshString = "lastRefresh";
+var batch = null;               // zone updates being collected into one message
+var locationStart = 0;          // when the current position was asked for
+
+var OUTBOX_RETRY_BASE = 1000;   // delay before the first retry of a failed send (ms)
+var OUTBOX_RETRY_MAX  = 60000;  // longest delay between retries (ms)
+var OUTBOX_MAX_KEYS   = 32;     // most keys waiting to go to the watch
+var outbox = {
+    "pending"    : {},          // key -> value (or function returning it) still to be sent
+    "count"      : 0,           // number of keys in pending
+    "inFlight"   : null,        // pending entries of the message being sent
+    "sentAt"     : 0,
+    "retries"    : 0,
+    "retryTimer" : null,
+    "stats"      : {
+        "sent"      : 0,
+        "nacked"    : 0,
+        "coalesced" : 0,        // pending values replaced by newer ones before being sent
+        "dropped"   : 0,        // keys refused because the outbox was full
+        "latency"   : 0,        // total ms from send to ACK
+        "maxLatency": 0
+    }
+};
+
 /*
  * Get the default values, if they exist. If not, initialize them.
  */
@@ -21,17 +131,18 @@ function getDefaults() {
     var defaults = [];
     var tmpFioKey;
 //    localStorage.clear();
+    var count = Math.min(+localStorage.getItem(zoneCountString) || DEFAULT_ZONES.length, MAX_ZONES);
     tmpFioKey = localStorage.getItem(fioKeyString);
     if (!tmpFioKey) tmpFioKey = "";
-    for (var i = 0; i < 3; i++ ) {
+    for (var i = 0; i < count; i++ ) {
         defString = localStorage.getItem("defaults" + i);
         if ( defString === null ) {
             tmpDefaults = {
                             "background" : 0,
                             "timedisp"   : 0,
-                            "latitude"   : (i === 0) ? 0 : (i === 1) ? 51.507200 :  35.689500,
-                            "longitude"  : (i === 0) ? 0 : (i === 1) ?  0.127500 : 139.691700,
-                            "city"       : (i === 0) ? "Local" : (i === 1) ? "London, England" : "Tokyo, Japan",
+                            "latitude"   : DEFAULT_ZONES[i] ? DEFAULT_ZONES[i].latitude : 0,
+                            "longitude"  : DEFAULT_ZONES[i] ? DEFAULT_ZONES[i].longitude : 0,
+                            "city"       : DEFAULT_ZONES[i] ? DEFAULT_ZONES[i].city : "",
                             "timezone"   : 0
                           };
             localStorage.setItem("defaults" + i, JSON.stringify(tmpDefaults));
@@ -46,6 +157,60 @@ function getDefaults() {
               };
 }
 
+/*
+ * Number of zones configured, as shown on the watch
+ */
+function zoneCount() {
+    return Math.min(appData.defaults.length, MAX_ZONES);
+}
+
+/*
+ * AppMessage key for one of a zone's values: the keys are grouped by KEYS_PER_WATCH per zone
+ */
+function zoneKey(watch, key) {
+    return watch * KEYS_PER_WATCH + key;
+}
+
+/*
+ * Pulls the fields the watch uses out of a forecast.io response into a flat record, so the
+ * parsed document can be dropped straight away. Returns null if any of them is missing.
+ *
+ *   offset       GMT offset in seconds
+ *   timezone     IANA zone name, for offsetTransitions()
+ *   temperature  current temperature, rounded
+ *   icon[3]      current conditions, then tomorrow's and the next day's
+ *   max[3]       daily highs, rounded, today first
+ *   min[3]       daily lows, rounded, today first
+ */
+function parseForecast(text) {
+    var response, daily;
+    var forecast = { "icon" : [], "max" : [], "min" : [] };
+
+    try {
+        response = JSON.parse(text);
+        daily = response.daily.data;
+        forecast.offset      = response.offset * 3600;
+        forecast.timezone    = response.timezone;
+        forecast.temperature = Math.round(response.currently.temperature);
+        forecast.icon.push(response.currently.icon);
+        for (var i = 0; i < 3; i++) {
+            if (i > 0) {
+                forecast.icon.push(daily[i].icon);
+            }
+            forecast.max.push(Math.round(daily[i].temperatureMax));
+            forecast.min.push(Math.round(daily[i].temperatureMin));
+        }
+    } catch (e) {
+        console.log("parseForecast: " + e);
+        return null;
+    }
+    if (isNaN(forecast.offset) || isNaN(forecast.temperature) ||
+        isNaN(forecast.max.concat(forecast.min).reduce(function (a, b) { return a + b; }))) {
+        return null;
+    }
+    return forecast;
+}
+
 /*
  * Converts strings returned from forecast.io to values used on the watch
  */
@@ -71,133 +236,632 @@ function iconFromWeatherId(weatherId) {
     }
 }
 
-function sendQueueToPebble() {
+/*
+ * True if count weather bytes from start are the same in both arrays
+ */
+function sameBytes(a, b, start, count) {
+    for (var i = start; i < start + count; i++) {
+        if (a[i] !== b[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * UTF-8 bytes of a string, cut at maxLen without splitting a character
+ */
+function utf8Bytes(str, maxLen) {
+    var utf8 = unescape(encodeURIComponent(str));
+    var len = Math.min(utf8.length, maxLen);
+    var bytes = [];
+    if (len < utf8.length) {
+        while (len > 0 && (utf8.charCodeAt(len) & 0xC0) === 0x80) {
+            len--;
+        }
+    }
+    for (var i = 0; i < len; i++) {
+        bytes.push(utf8.charCodeAt(i));
+    }
+    return bytes;
+}
 
-    if (pbl_msg_queue.length > 0) {
-        var nextMessage = pbl_msg_queue.shift();
-        console.log("Sending msg: " + JSON.stringify(nextMessage));
-        Pebble.sendAppMessage (
-            nextMessage,
-            function (e) {
-                sendQueueToPebble();
-            },
-            function (e) {
-                console.log("sendQueueToPebble, message failed to send: " + e.data.transactionId +
-                            ", message: " + JSON.stringify(nextMessage));
-                pbl_msg_queue.push(nextMessage);
+/*
+ * GMT offset, in seconds, of the zone a formatter is set up for at the given time
+ */
+function zoneOffsetAt(formatter, ms) {
+    var parts = formatter.formatToParts(new Date(ms));
+    var field = {};
+    for (var i = 0; i < parts.length; i++) {
+        field[parts[i].type] = +parts[i].value;
+    }
+    var wallClock = Date.UTC(field.year, field.month - 1, field.day, field.hour % 24,
+                             field.minute, field.second);
+    return Math.round((wallClock - ms) / 1000);
+}
+
+/*
+ * Finds the next few GMT offset changes (DST starting or ending) for an IANA time zone, so the
+ * watch can switch at the exact minute without asking. Returns [] if the phone's JavaScript
+ * can't work out zone offsets.
+ */
+function offsetTransitions(timezone, now) {
+    var transitions = [];
+    var formatter;
+    var start = Math.floor(now / MINUTE_MS) * MINUTE_MS;
+    var offset, next, lo, hi, mid;
+
+    try {
+        formatter = new Intl.DateTimeFormat("en-US", {
+            "timeZone" : timezone, "hour12" : false,
+            "year"     : "numeric", "month"  : "numeric", "day"    : "numeric",
+            "hour"     : "numeric", "minute" : "numeric", "second" : "numeric"
+        });
+        if (!formatter.formatToParts) {
+            return transitions;
+        }
+        offset = zoneOffsetAt(formatter, start);
+    } catch (e) {
+        console.log("offsetTransitions: no offsets for " + timezone + ": " + e);
+        return transitions;
+    }
+    for (var day = 0; day < TRANSITION_SCAN_DAYS && transitions.length < MAX_TRANSITIONS; day++) {
+        next = zoneOffsetAt(formatter, start + DAY_MS);
+        if (next !== offset) {
+            // Narrow down to the first minute on the new offset
+            lo = start;
+            hi = start + DAY_MS;
+            while (hi - lo > MINUTE_MS) {
+                mid = lo + Math.floor((hi - lo) / 2 / MINUTE_MS) * MINUTE_MS;
+                if (zoneOffsetAt(formatter, mid) === offset) {
+                    lo = mid;
+                } else {
+                    hi = mid;
+                }
             }
-        );
+            transitions.push({ "at" : hi / 1000, "offset" : next });
+            offset = next;
+        }
+        start += DAY_MS;
     }
+    return transitions;
 }
 
 /*
- * Gets the weather information for a particular lat/long. Sends the return values to the watch.
+ * offsetTransitions() for a zone, worked out again only once its first transition has passed,
+ * or after a day if it has none
  */
-function fetchWeather(watch, latitude, longitude) {
-    var response;
+function zoneTransitions(timezone, now) {
+    var entry = transitionCache[timezone];
+    if (!entry || now >= entry.until) {
+        entry = { "transitions" : offsetTransitions(timezone, now) };
+        entry.until = (entry.transitions.length > 0) ? entry.transitions[0].at * 1000 : now + DAY_MS;
+        transitionCache[timezone] = entry;
+    }
+    return entry.transitions.filter(function (transition) {
+        return transition.at * 1000 > now;
+    });
+}
+
+/*
+ * PBCOMM_TRANSITIONS_KEY data: each transition's UTC time, then its offset in quarter hours.
+ * No transitions is a single 0 byte, which clears the watch's table.
+ */
+function encodeTransitions(transitions) {
+    var bytes = [];
+    if (transitions.length === 0) {
+        return [0];
+    }
+    for (var i = 0; i < transitions.length; i++) {
+        for (var j = 0; j < 4; j++) {
+            bytes.push((transitions[i].at >>> (8 * j)) & 0xFF);
+        }
+        bytes.push(Math.round(transitions[i].offset / 900) & 0xFF);
+    }
+    return bytes;
+}
+
+/*
+ * Builds the v2 update for a zone: a version/sequence/fields header, then only the fields that
+ * differ from what was last sent. If nothing was sent yet, everything goes with UPDATE_FULL.
+ * An update with no fields still refreshes the watch's last weather update time.
+ */
+function encodeZoneUpdate(watch, zone) {
+    var last = zoneSent[watch];
+    var fields = 0;
+    var body = [];
+    var i, city;
+
+    if (!last) {
+        fields |= UPDATE_FULL;
+    }
+    if (!last || last.offset !== zone.offset) {
+        fields |= UPDATE_HAS_OFFSET;
+        for (i = 0; i < 4; i++) {
+            body.push((zone.offset >> (8 * i)) & 0xFF);
+        }
+    }
+    if (!last || last.background !== zone.background) {
+        fields |= UPDATE_HAS_BACKGROUND;
+        body.push(zone.background & 0xFF);
+    }
+    if (!last || last.timedisp !== zone.timedisp) {
+        fields |= UPDATE_HAS_DISPLAY;
+        body.push(zone.timedisp & 0xFF);
+    }
+    if (!last || !sameBytes(last.weather, zone.weather, WEATHER_ICONS, 3)) {
+        fields |= UPDATE_HAS_ICONS;
+        for (i = WEATHER_ICONS; i < WEATHER_ICONS + 3; i++) {
+            body.push(zone.weather[i] & 0xFF);
+        }
+    }
+    if (!last || !sameBytes(last.weather, zone.weather, CURRENT_TEMP, 7)) {
+        fields |= UPDATE_HAS_TEMPS;
+        for (i = CURRENT_TEMP; i < CURRENT_TEMP + 7; i++) {
+            body.push(zone.weather[i] & 0xFF);
+        }
+    }
+    if (!last || last.city !== zone.city) {
+        fields |= UPDATE_HAS_CITY;
+        city = utf8Bytes(zone.city, MAX_CITY_LEN - 1);
+        body.push(city.length);
+        body = body.concat(city);
+    }
+    zoneSequence[watch] = ((zoneSequence[watch] || 0) + 1) & 0xFF;
+    zoneSent[watch] = zone;
+    return [UPDATE_PROTOCOL_V2, zoneSequence[watch], fields].concat(body);
+}
+
+/*
+ * Starts collecting zone updates so a refresh of every zone reaches the watch as one message,
+ * which the watch applies and redraws in a single pass. Returns the batch, which each zone's
+ * callbacks carry so that answers for an older batch can be told apart. A batch still open
+ * is sent with what it has; the new one refreshes every zone, so its stragglers are dropped.
+ */
+function beginBatch(zones) {
+    if (batch) {
+        batch.superseded = true;
+        flushBatch();
+    }
+    batch = {
+        "message" : {},
+        "waiting" : zones,
+        "timer"   : setTimeout(flushBatch, BATCH_TIMEOUT)
+    };
+    fetchStats = { "fetches" : 0, "bytes" : 0, "parseMs" : 0 };
+    if (zoneCountSent !== zones) {
+        batch.message[PBCOMM_ZONE_COUNT_KEY] = zones;
+        zoneCountSent = zones;
+    }
+    return batch;
+}
+
+function flushBatch() {
+    if (!batch) {
+        return;
+    }
+    clearTimeout(batch.timer);
+    console.log("refresh: " + fetchStats.fetches + " forecasts, " + fetchStats.bytes +
+                " bytes, parsed in " + fetchStats.parseMs + "ms; cache " + cacheStats());
+    if (batch.timing) {
+        batch.message[PBCOMM_TIMING_KEY] = encodeTiming.bind(null, batch.timing);
+    }
+    if (Object.keys(batch.message).length > 0) {
+        outboxQueue(batch.message);
+        localStorage.setItem(lastRefreshString, Date.now());
+    }
+    batch = null;
+}
+
+/*
+ * Adds a zone's keys to batch b, or sends them straight away if b has already gone out on its
+ * own. Keys for a batch a newer one replaced are dropped. Pass no keys when a zone's refresh
+ * failed, so the batch doesn't wait for it.
+ */
+function batchZoneDone(b, keys) {
+    var key;
+    if (b && b.superseded) {
+        for (key in keys) {
+            if (keys.hasOwnProperty(key)) {
+                forgetSent(key);
+            }
+        }
+        return;
+    }
+    if (b !== batch) {
+        if (keys) {
+            outboxQueue(keys);
+        }
+        return;
+    }
+    for (key in keys) {
+        if (keys.hasOwnProperty(key)) {
+            b.message[key] = keys[key];
+        }
+    }
+    if (--b.waiting <= 0) {
+        flushBatch();
+    }
+}
+
+/*
+ * Notes how long a stage of answering the watch's request took, keeping the longest if the
+ * stage runs more than once. Nothing is noted once batch b has gone out.
+ */
+function noteTiming(b, stage, ms) {
+    if (b && b === batch && b.timing) {
+        b.timing[stage] = Math.max(b.timing[stage], ms);
+    }
+}
+
+/*
+ * Lays out a request's timing as PBCOMM_TIMING_KEY data. Called as the reply is sent, so the
+ * phone's time includes any wait in the outbox.
+ */
+function encodeTiming(timing) {
+    var values = [timing.id, timing.geolocation, timing.http, Date.now() - timing.receivedAt];
+    var bytes = [];
+    for (var i = 0; i < values.length; i++) {
+        var value = Math.max(0, Math.min(0xFFFF, Math.round(values[i])));
+        bytes.push(value & 0xFF, value >> 8);
+    }
+    return bytes;
+}
+
+/*
+ * Prints the records from a PBCOMM_LOG_KEY message, laid out as in PWTimeKeys.h. A "/" in
+ * B's name means it's packed bytes, shown signed, one per name. B may also be a function
+ * that formats it.
+ */
+function printEventLog(data) {
+    for (var pos = 0; pos + LOG_RECORD_LEN <= data.length; pos += LOG_RECORD_LEN) {
+        var r = data.slice(pos, pos + LOG_RECORD_LEN);
+        var time = (r[0] | (r[1] << 8) | (r[2] << 16) | (r[3] << 24)) >>> 0;
+        var a = (r[6] | (r[7] << 8)) << 16 >> 16;
+        var b = r[8] | (r[9] << 8) | (r[10] << 16) | (r[11] << 24);
+        var format = EVENT_FORMATS[r[4]] || [ "event " + r[4], "a", "b" ];
+        var line = new Date(time * 1000).toISOString() + " " + (EVENT_LEVELS[r[5]] || r[5]) +
+                   " " + format[0];
+        if (typeof format[1] === "function") {
+            line += ", " + format[1](a);
+        } else if (format[1]) {
+            line += ", " + format[1] + ": " + a;
+        }
+        if (typeof format[2] === "function") {
+            line += ", " + format[2](b);
+        } else if (format[2] && format[2].indexOf("/") >= 0) {
+            var names = format[2].split("/");
+            var bytes = [];
+            for (var i = 0; i < names.length; i++) {
+                bytes.push(r[8 + i] << 24 >> 24);
+            }
+            line += ", " + format[2] + ": " + bytes.join("/");
+        } else if (format[2]) {
+            line += ", " + format[2] + ": " + b;
+        }
+        console.log(line);
+    }
+}
+
+/*
+ * Refreshes every zone: the local one from the current position, the others from their
+ * configured coordinates. A request ID from the watch is echoed back with timing for each
+ * stage of the refresh.
+ */
+function refreshAllZones(requestId) {
+    var b = beginBatch(zoneCount());
+    if (requestId !== undefined) {
+        b.timing = {
+            "id"          : requestId,
+            "receivedAt"  : Date.now(),
+            "geolocation" : 0,
+            "http"        : 0
+        };
+    }
+    locationStart = Date.now();
+    navigator.geolocation.getCurrentPosition(function (pos) {
+                                                 locationSuccess(b, pos);
+                                             },
+                                             function (err) {
+                                                 locationError(b, err);
+                                             }, getlocationOptions);
+    for (var i = 1; i < zoneCount(); i++ ) {
+        fetchWeather(b, i, appData.defaults[i].latitude, appData.defaults[i].longitude);
+    }
+}
+
+/*
+ * Cache keys round coordinates to 0.01 degree, about a kilometre, so small GPS jitter
+ * still finds the same entry.
+ */
+function cacheKey(kind, latitude, longitude) {
+    return CACHE_PREFIX + kind + ":" + (+latitude).toFixed(2) + "," + (+longitude).toFixed(2);
+}
+
+function cacheStats() {
+    var st = cache.stats;
+    return "hits: " + st.hits + ", misses: " + st.misses + ", shared: " + st.shared;
+}
+
+/*
+ * Calls done(value) with the cached value for key if it has not expired. Otherwise calls
+ * fetch(store) unless a fetch for key is already running, in which case done waits on that
+ * one. The fetch calls store(value, keep) when it finishes; value goes to every waiting
+ * caller and is cached for ttl ms if keep is set.
+ */
+function cachedFetch(key, ttl, fetch, done) {
+    var entry = null;
+    try {
+        entry = JSON.parse(localStorage.getItem(key));
+    } catch (e) {
+    }
+    if (entry && Date.now() < entry.expires) {
+        cache.stats.hits++;
+        done(entry.value);
+        return;
+    }
+    if (cache.inFlight[key]) {
+        cache.stats.shared++;
+        cache.inFlight[key].push(done);
+        return;
+    }
+    cache.stats.misses++;
+    cache.inFlight[key] = [done];
+    fetch(function (value, keep) {
+        var waiting = cache.inFlight[key];
+        delete cache.inFlight[key];
+        if (keep) {
+            localStorage.setItem(key, JSON.stringify({ "expires" : Date.now() + ttl, "value" : value }));
+        }
+        for (var i = 0; i < waiting.length; i++) {
+            waiting[i](value);
+        }
+    });
+}
+
+/*
+ * Drops expired cache entries, so places visited once do not stay in localStorage.
+ */
+function pruneCache() {
+    var key, entry;
+    var expired = [];
+    for (var i = 0; i < localStorage.length; i++) {
+        key = localStorage.key(i);
+        if (key && key.indexOf(CACHE_PREFIX) === 0) {
+            try {
+                entry = JSON.parse(localStorage.getItem(key));
+            } catch (e) {
+                entry = null;
+            }
+            if (!entry || Date.now() >= entry.expires) {
+                expired.push(key);
+            }
+        }
+    }
+    for (i = 0; i < expired.length; i++) {
+        localStorage.removeItem(expired[i]);
+    }
+}
+
+function outboxStats() {
+    var st = outbox.stats;
+    return "sent: " + st.sent + ", nacked: " + st.nacked + ", coalesced: " + st.coalesced +
+           ", dropped: " + st.dropped + ", avg latency: " +
+           (st.sent ? Math.round(st.latency / st.sent) : 0) + "ms, max: " + st.maxLatency + "ms";
+}
+
+/*
+ * Adds a message's keys to the outbox. Each key holds only its newest value, so data that is
+ * superseded before it goes out is never sent. A value may be a function, which is called when
+ * the message is actually sent (used for v2 updates, which are deltas against the last send).
+ * A key refused because the outbox is full is forgotten, so the next refresh sends it in full.
+ */
+function outboxQueue(message) {
+    for (var key in message) {
+        if (message.hasOwnProperty(key)) {
+            if (outbox.pending.hasOwnProperty(key)) {
+                outbox.stats.coalesced++;
+            } else if (outbox.count >= OUTBOX_MAX_KEYS) {
+                outbox.stats.dropped++;
+                forgetSent(key);
+                continue;
+            } else {
+                outbox.count++;
+            }
+            outbox.pending[key] = message[key];
+        }
+    }
+    outboxSend();
+}
+
+/*
+ * Sends everything pending as one message, unless a send is already in flight or waiting to
+ * be retried.
+ */
+function outboxSend() {
+    var message = {};
+    var key;
+
+    if (outbox.inFlight || outbox.retryTimer || outbox.count === 0) {
+        return;
+    }
+    outbox.inFlight = outbox.pending;
+    outbox.pending = {};
+    outbox.count = 0;
+    for (key in outbox.inFlight) {
+        if (outbox.inFlight.hasOwnProperty(key)) {
+            message[key] = (typeof outbox.inFlight[key] === "function") ? outbox.inFlight[key]() :
+                                                                          outbox.inFlight[key];
+        }
+    }
+    console.log("Sending msg: " + JSON.stringify(message));
+    outbox.sentAt = Date.now();
+    Pebble.sendAppMessage(message, outboxAck, outboxNack);
+}
+
+function outboxAck(e) {
+    var latency = Date.now() - outbox.sentAt;
+    outbox.stats.sent++;
+    outbox.stats.latency += latency;
+    outbox.stats.maxLatency = Math.max(outbox.stats.maxLatency, latency);
+    outbox.inFlight = null;
+    outbox.retries = 0;
+    console.log("outboxAck, " + outboxStats());
+    outboxSend();
+}
+
+/*
+ * Marks a key's value as not on the watch, so the next refresh sends it again in full
+ */
+function forgetSent(key) {
+    if (+key % KEYS_PER_WATCH === PBCOMM_UPDATE_KEY) {
+        zoneSent[Math.floor(+key / KEYS_PER_WATCH)] = undefined;
+    } else if (+key % KEYS_PER_WATCH === PBCOMM_TRANSITIONS_KEY) {
+        transitionsSent[Math.floor(+key / KEYS_PER_WATCH)] = undefined;
+    } else if (+key % KEYS_PER_WATCH === PBCOMM_LOCATION_KEY) {
+        locationSent[Math.floor(+key / KEYS_PER_WATCH)] = undefined;
+    }
+}
+
+/*
+ * Puts a failed message's keys back, unless newer values arrived meanwhile, and retries with
+ * exponential backoff. A lost v2 update can't be replayed as a delta, so its zone is resent
+ * in full.
+ */
+function outboxNack(e) {
+    var failed = outbox.inFlight;
+    var delay;
+
+    outbox.stats.nacked++;
+    outbox.inFlight = null;
+    for (var key in failed) {
+        if (failed.hasOwnProperty(key)) {
+            forgetSent(key);
+            if (outbox.pending.hasOwnProperty(key)) {
+                outbox.stats.coalesced++;
+            } else if (outbox.count < OUTBOX_MAX_KEYS) {
+                outbox.pending[key] = failed[key];
+                outbox.count++;
+            } else {
+                outbox.stats.dropped++;
+            }
+        }
+    }
+    delay = Math.min(OUTBOX_RETRY_BASE * Math.pow(2, outbox.retries), OUTBOX_RETRY_MAX);
+    outbox.retries++;
+    console.log("outboxNack, retry in " + delay + "ms, " + outboxStats());
+    outbox.retryTimer = setTimeout(function () {
+        outbox.retryTimer = null;
+        outboxSend();
+    }, delay);
+}
+
+/*
+ * Requests the forecast for a lat/long from forecast.io for batch b. Calls store with the
+ * parsed record, or null if there is none.
+ */
+function requestForecast(b, latitude, longitude, store) {
+    var forecast;
+    var parseStart;
+    var started = Date.now();
     var req = new XMLHttpRequest();
-    console.log("fetchWeather.");
+    console.log("requestForecast.");
     req.open('GET', "http://api.forecast.io/forecast/" + appData.fioKey + "/" +
-                    latitude + "," + longitude, true);
+                    latitude + "," + longitude + "?exclude=" + FORECAST_EXCLUDE, true);
     req.onload = function (e) {
-        console.log("fetchWeather req.status: " + req.status + ", watch: " + watch);
+        console.log("requestForecast req.status: " + req.status);
+        noteTiming(b, "http", Date.now() - started);
         if(req.status == 200) {
-            response = JSON.parse(req.responseText);
-            appData.defaults[watch].timezone = response.offset * 3600;
-            localStorage.setItem("defaults" + watch,  JSON.stringify(appData.defaults[watch]));
-            var sunrise_date  = new Date((response.daily.data[0].sunriseTime -
-                                          appData.defaults[0].timezone +
-                                          appData.defaults[watch].timezone) * 1000);
-            var sunset_date   = new Date((response.daily.data[0].sunsetTime -
-                                          appData.defaults[0].timezone +
-                                          appData.defaults[watch].timezone) * 1000);
-            var message;
-            
-            switch (watch) {
-            case 0:
-                message = {
-                    "offset_w0"     : (response.offset * 3600),
-                    "city_w0"       : appData.defaults[watch].city,
-                    "background_w0" : +appData.defaults[watch].background,
-                    "timedisp_w0"   : +appData.defaults[watch].timedisp,
-                    "weather_w0"    : [ iconFromWeatherId(response.currently.icon),
-                                        iconFromWeatherId(response.daily.data[1].icon),
-                                        iconFromWeatherId(response.daily.data[2].icon),
-                                        Math.round(response.currently.temperature),
-                                        Math.round(response.daily.data[0].temperatureMax),
-                                        Math.round(response.daily.data[1].temperatureMax),
-                                        Math.round(response.daily.data[2].temperatureMax),
-                                        Math.round(response.daily.data[0].temperatureMin),
-                                        Math.round(response.daily.data[1].temperatureMin),
-                                        Math.round(response.daily.data[2].temperatureMin),
-                                        sunrise_date.getHours(),
-                                        sunrise_date.getMinutes(),
-                                        sunset_date.getHours(),
-                                        sunset_date.getMinutes()                            ]};
-                pbl_msg_queue.push(message);
-                sendQueueToPebble();
-                break;
-            case 1:
-                 message = {
-                    "offset_w1"     : (response.offset * 3600),
-                    "city_w1"       : appData.defaults[watch].city,
-                    "background_w1" : +appData.defaults[watch].background,
-                    "timedisp_w1"   : +appData.defaults[watch].timedisp,
-                    "weather_w1"    : [ iconFromWeatherId(response.currently.icon),
-                                        iconFromWeatherId(response.daily.data[1].icon),
-                                        iconFromWeatherId(response.daily.data[2].icon),
-                                        Math.round(response.currently.temperature),
-                                        Math.round(response.daily.data[0].temperatureMax),
-                                        Math.round(response.daily.data[1].temperatureMax),
-                                        Math.round(response.daily.data[2].temperatureMax),
-                                        Math.round(response.daily.data[0].temperatureMin),
-                                        Math.round(response.daily.data[1].temperatureMin),
-                                        Math.round(response.daily.data[2].temperatureMin),
-                                        sunrise_date.getHours(),
-                                        sunrise_date.getMinutes(),
-                                        sunset_date.getHours(),
-                                        sunset_date.getMinutes()                            ]};
-                pbl_msg_queue.push(message);
-                break;
-            case 2:
-                message = {
-                    "offset_w2"     : (response.offset * 3600),
-                    "city_w2"       : appData.defaults[watch].city,
-                    "background_w2" : +appData.defaults[watch].background,
-                    "timedisp_w2"   : +appData.defaults[watch].timedisp,
-                    "weather_w2"    : [ iconFromWeatherId(response.currently.icon),
-                                        iconFromWeatherId(response.daily.data[1].icon),
-                                        iconFromWeatherId(response.daily.data[2].icon),
-                                        Math.round(response.currently.temperature),
-                                        Math.round(response.daily.data[0].temperatureMax),
-                                        Math.round(response.daily.data[1].temperatureMax),
-                                        Math.round(response.daily.data[2].temperatureMax),
-                                        Math.round(response.daily.data[0].temperatureMin),
-                                        Math.round(response.daily.data[1].temperatureMin),
-                                        Math.round(response.daily.data[2].temperatureMin),
-                                        sunrise_date.getHours(),
-                                        sunrise_date.getMinutes(),
-                                        sunset_date.getHours(),
-                                        sunset_date.getMinutes()                            ]};
-                pbl_msg_queue.push(message);
-                sendQueueToPebble();
-                break;
-            default:
-                message = "";
-                break;
-            }
-            if (message !== "") {
-            } else {
-                console.log("fetchWeather bad watch: " + watch);
-            }
+            parseStart = Date.now();
+            forecast = parseForecast(req.responseText);
+            fetchStats.bytes += req.responseText.length;
+            fetchStats.parseMs += Date.now() - parseStart;
+            fetchStats.fetches++;
+            store(forecast, forecast !== null);
         } else {                // if (req.status == 200)
-            console.log("fetchWeather: Error, request status: " + req.status + ", lat: " +
+            console.log("requestForecast: Error, request status: " + req.status + ", lat: " +
                         latitude, ", long: " + longitude);
+            store(null, false);
         }
     };
+    req.onerror = function (e) {
+        console.log("requestForecast: request failed, lat: " + latitude + ", long: " + longitude);
+        noteTiming(b, "http", Date.now() - started);
+        store(null, false);
+    };
     req.send(null);
 }
 
+/*
+ * Gets the weather information for a particular lat/long, from the cache if a recent forecast
+ * for about the same place is there. Sends the return values to the watch.
+ */
+function fetchWeather(b, watch, latitude, longitude) {
+    cachedFetch(cacheKey("forecast", latitude, longitude), FORECAST_TTL,
+                function (store) {
+                    requestForecast(b, latitude, longitude, store);
+                },
+                function (forecast) {
+                    if (!forecast) {
+                        console.log("fetchWeather: no forecast, watch: " + watch);
+                        batchZoneDone(b);
+                        return;
+                    }
+                    sendForecast(b, watch, forecast);
+                });
+}
+
+/*
+ * Lays out a zone's position as PBCOMM_LOCATION_KEY data, for the watch's sunrise/sunset
+ */
+function encodeLocation(latitude, longitude) {
+    var bytes = [];
+    [latitude, longitude].forEach(function (degrees) {
+        var value = Math.round(+degrees * 100) & 0xFFFF;
+        bytes.push(value & 0xFF, value >> 8);
+    });
+    return bytes;
+}
+
+/*
+ * Builds a zone update from a forecast record and adds it to batch b.
+ */
+function sendForecast(b, watch, forecast) {
+    appData.defaults[watch].timezone = forecast.offset;
+    localStorage.setItem("defaults" + watch,  JSON.stringify(appData.defaults[watch]));
+    var zone = {
+        "offset"     : forecast.offset,
+        "city"       : appData.defaults[watch].city,
+        "background" : +appData.defaults[watch].background,
+        "timedisp"   : +appData.defaults[watch].timedisp,
+        "weather"    : [ iconFromWeatherId(forecast.icon[0]),
+                         iconFromWeatherId(forecast.icon[1]),
+                         iconFromWeatherId(forecast.icon[2]),
+                         forecast.temperature,
+                         forecast.max[0],
+                         forecast.max[1],
+                         forecast.max[2],
+                         forecast.min[0],
+                         forecast.min[1],
+                         forecast.min[2]                                     ]};
+    var message = {};
+    message[zoneKey(watch, PBCOMM_UPDATE_KEY)] = function () {
+        return encodeZoneUpdate(watch, zone);
+    };
+    // Always compared, even when empty, so a table left from the zone's old place is cleared
+    var transitions = encodeTransitions(zoneTransitions(forecast.timezone, Date.now()));
+    if (transitionsSent[watch] !== transitions.join()) {
+        message[zoneKey(watch, PBCOMM_TRANSITIONS_KEY)] = transitions;
+        transitionsSent[watch] = transitions.join();
+    }
+    var location = encodeLocation(appData.defaults[watch].latitude, appData.defaults[watch].longitude);
+    if (locationSent[watch] !== location.join()) {
+        message[zoneKey(watch, PBCOMM_LOCATION_KEY)] = location;
+        locationSent[watch] = location.join();
+    }
+    batchZoneDone(b, message);
+}
+
 function cityFromGeocodeResults(results) {
     var cityState    = "";
     var locality     = "";
@@ -227,74 +891,101 @@ function cityFromGeocodeResults(results) {
     return cityState;
 }
         
-function getCity(watch_num, latitude, longitude) {
+/*
+ * Reverse geocodes a lat/long with Google for batch b. Calls store with the city name, or
+ * null if the request could not be made at all. Only real answers are kept in the cache.
+ */
+function requestCity(b, latitude, longitude, store) {
     var response;
-       var cityState = "";
+    var started = Date.now();
     var req = new XMLHttpRequest();
     req.open('GET', "https://maps.googleapis.com/maps/api/geocode/json?latlng="+
                     latitude + "," + longitude + "&sensor=false", true);
     req.onload = function (e) {
+        noteTiming(b, "http", Date.now() - started);
         if(req.status == 200) {
             response = JSON.parse(req.responseText);
             if (response.status != "ZERO_RESULTS") {
-                cityState = cityFromGeocodeResults(response.results);
+                store(cityFromGeocodeResults(response.results), true);
             } else {
-                cityState = "ZERO_RESULTS";
                 console.log("Cannot reverse geocode, lat: " + latitude, + ", long: " + longitude);
+                store("ZERO_RESULTS", true);
             }
         } else {
-            cityState = "Geocode Failed";
-            console.log("getCity: reverse geocode failed: " + req.status);
+            console.log("requestCity: reverse geocode failed: " + req.status);
+            store("Geocode Failed", false);
         }
-        appData.defaults[watch_num].city = cityState;
-        localStorage.setItem("defaults" + watch_num,  JSON.stringify(appData.defaults[watch_num]));
-        Pebble.sendAppMessage (
-            {
-               "city_w0":cityState,
-            }
-        );
-        fetchWeather(watch_num, latitude, longitude);
+    };
+    req.onerror = function (e) {
+        console.log("requestCity: reverse geocode request failed");
+        noteTiming(b, "http", Date.now() - started);
+        store(null, false);
     };
     req.send(null);
 }
 
-function locationSuccess(pos) {
+function getCity(b, watch_num, latitude, longitude) {
+    cachedFetch(cacheKey("city", latitude, longitude), GEOCODE_TTL,
+                function (store) {
+                    requestCity(b, latitude, longitude, store);
+                },
+                function (cityState) {
+                    if (cityState !== null) {
+                        appData.defaults[watch_num].city = cityState;
+                        localStorage.setItem("defaults" + watch_num,  JSON.stringify(appData.defaults[watch_num]));
+                    }
+                    fetchWeather(b, watch_num, latitude, longitude);
+                });
+}
+
+function locationSuccess(b, pos) {
     console.log("locationSuccess.");
+    noteTiming(b, "geolocation", Date.now() - locationStart);
     appData.defaults[0].latitude = pos.coords.latitude;
     appData.defaults[0].longitude = pos.coords.longitude;
     localStorage.setItem("defaults0", JSON.stringify(appData.defaults[0]));
-    setTimeout(getCity(0, pos.coords.latitude, pos.coords.longitude), 1500); // Always watch 0 for location service
+    getCity(b, 0, pos.coords.latitude, pos.coords.longitude); // Always watch 0 for location service
 }
 
-function locationError(err) {
+function locationError(b, err) {
+    var message = {};
     console.warn('Location error (' + err.code + '): ' + err.message);
-    Pebble.sendAppMessage (
-        {
-            "city_w0":"Loc Unavailable",
-        }
-    );
+    noteTiming(b, "geolocation", Date.now() - locationStart);
+    if (zoneSent[0]) {
+        zoneSent[0].city = "Loc Unavailable";   // so the real city is resent once we have it
+    }
+    message[zoneKey(0, PBCOMM_CITY_KEY)] = "Loc Unavailable";
+    batchZoneDone(b, message);
 }
 
 Pebble.addEventListener("ready",
                         function(e) {
 //                            console.log("ready event");
                             getDefaults();
+                            pruneCache();
 //                            locationWatcher = navigator.geolocation.watchPosition(locationSuccess,
 //                                                locationError, watchlocationOptions);
-                            navigator.geolocation.getCurrentPosition(locationSuccess,
-                                                locationError, getlocationOptions);
-                            fetchWeather(1, appData.defaults[1].latitude, appData.defaults[1].longitude);
-                            fetchWeather(2, appData.defaults[2].latitude, appData.defaults[2].longitude);
+                            // The watch restores its last known data and asks for a refresh
+                            // itself if that has gone stale.
+                            if (Date.now() - (+localStorage.getItem(lastRefreshString)) > FRESH_INTERVAL) {
+                                refreshAllZones();
+                            }
                         });
 
 Pebble.addEventListener("appmessage",
                         function(e) {
 //                            console.log("appmessage event: " + JSON.stringify(e.payload));
-                            navigator.geolocation.getCurrentPosition(locationSuccess,
-                                                locationError, getlocationOptions);
-                            for (var i=1; i < 3; i++ ) {
-                                fetchWeather(i, appData.defaults[i].latitude, appData.defaults[i].longitude);
+                            if (e.payload.log) {
+                                printEventLog(e.payload.log);
+                                return;
+                            }
+                            if (e.payload.request === REQUEST_FULL_UPDATE) {
+                                zoneSent = [];
+                                zoneCountSent = undefined;
+                                transitionsSent = [];
+                                locationSent = [];
                             }
+                            refreshAllZones(e.payload.request_id);
                         });
                         
 Pebble.addEventListener("showConfiguration",
@@ -313,9 +1004,15 @@ Pebble.addEventListener("webviewclosed",
 //                                console.log("webviewclosed response: " + e.response);
                                 appData = JSON.parse(e.response);
                                 localStorage.setItem(fioKeyString, appData.fioKey);
-                                for (var i = 0; i < 3; i++ ) {
+                                localStorage.setItem(zoneCountString, zoneCount());
+                                var b = beginBatch(zoneCount());
+                                // Saving the configuration is the user's choice of worker
+                                if (appData.worker !== undefined) {
+                                    b.message[PBCOMM_WORKER_KEY] = appData.worker ? 1 : 0;
+                                }
+                                for (var i = 0; i < zoneCount(); i++ ) {
                                     localStorage.setItem("defaults" + i,  JSON.stringify(appData.defaults[i]));
-                                    getCity(i, appData.defaults[i].latitude, appData.defaults[i].longitude);
+                                    getCity(b, i, appData.defaults[i].latitude, appData.defaults[i].longitude);
                                 }
                             }                       // No configuration information returned (cancel)
                         });
\ No newline at end of file
@@ -1,17 +1,40 @@
 #include <pebble.h>
 #include "PWTimeKeys.h"
+#include "PWTimePersist.h"
+
+// Uncomment to collect per-call timing, layer_mark_dirty counts and heap deltas for the hot
+// paths, plus running totals of the work the app has caused since launch and a rough energy
+// score for it. The results are dumped with the other watchface data on a long SELECT press,
+// and SELECT on the status window flips it to a page showing them.
+// #define PERF_COUNTERS
 
 static GFont big_bold_font;
 static GFont med_bold_font;
 static GFont small_bold_font;
 
-static AppSync sync;
-static uint8_t sync_buffer[512];
-
-#define MAX_WATCH_FACES		3               // How many timezones do we support?
+#define MAX_WATCH_FACES		8               // How many timezones do we support?
+#define ROWS_PER_PAGE       3               // Zones on each page of the main window
+#define ROW_HEIGHT          56
 #define MAX_TEMPERATURE_LEN 16
 
-#define MINUTES_BETWEEN_WEATHER_UPDATES 30  // How often (in minutes) do we ask for a weather update?
+#define MINUTES_BETWEEN_WEATHER_UPDATES 30  // How old (in minutes) zone data gets before we ask for more
+#define LOW_BATTERY_PERCENT      20         // Refresh half as often at or below this charge
+#define CRITICAL_BATTERY_PERCENT 10         // and a quarter as often at or below this one
+#define RECONNECT_FRESH_SECS     300        // Data newer than this isn't refreshed on reconnect
+#define PERSIST_DELAY_MS    10000           // Wait for further changes before writing zone state
+#define REQUEST_RETRY_MS    3000            // Retry a request the phone couldn't take yet
+#define MAX_REQUEST_RETRIES 5
+#define REQUEST_TIMEOUT_MS  60000           // Stop waiting to time a reply after this long
+#define LATENCY_BUCKETS     8               // from LATENCY_FIRST_MS, doubling, the last open-ended
+#define LATENCY_FIRST_MS    250
+#define DETAIL_IDLE_MS      30000           // Keep a popped detail window this long before freeing it
+#define SECONDS_PER_DAY     86400
+
+// Work a message left for commit_zone_changes() to do on a watchface
+#define ZONE_CHANGED_TIME       0x01    // offset or display style changed, re-run update_time
+#define ZONE_CHANGED_BACKGROUND 0x02    // colours may have changed, re-run update_background
+#define ZONE_CHANGED_TEMPS      0x04    // re-run update_temps
+#define ZONE_CHANGED_SUNS       0x08    // next sunrise/sunset moved, reschedule the sun timer
 
 typedef enum DayOffset {
     PREVDAY,
@@ -19,33 +42,58 @@ typedef enum DayOffset {
     NEXTDAY
 } DayOffsetType;
 
+typedef enum TimeStyle {
+    TIME_STYLE_12H,                     // "9:05 AM"
+    TIME_STYLE_24H                      // "09h05"
+} TimeStyle;
+
+struct WatchFace;
+
+// The detail window, shared by every zone and only allocated while in use
 typedef struct {
     Window      *window;
-	int          background;
-	int          display;
+	struct WatchFace *zone;             // watchface the view currently shows
+	Layer       *layer;                 // draws everything in detail_update_proc()
+	char         temps[MAX_WEATHER_DAYS][MAX_TEMPERATURE_LEN];
+} DetailView;
+
+typedef struct WatchFace {
+	bool         visible;               // detail window is the topmost window
+	bool         stale;                 // time text skipped while off screen
+	uint8_t      background;
+	uint8_t      display;
 	int32_t      gmt_sec_offset;
+	int          zone_day;              // days since 1970 of zone_tm's date, plus one; 0 if none
+	struct tm    zone_tm;               // cached broken-down time in this zone
 	int          last_day;
 	int          last_month;
 	int          last_year;
 	time_t       last_weather_update;
-	int          temp;
-	int          hi_temp[MAX_WEATHER_DAYS];
-	int          lo_temp[MAX_WEATHER_DAYS];
+	int8_t       temp;                  // temperatures are whole degrees, as sent
+	int8_t       hi_temp[MAX_WEATHER_DAYS];
+	int8_t       lo_temp[MAX_WEATHER_DAYS];
 	uint8_t      sunrise_hour;
 	uint8_t      sunrise_min;
 	uint8_t      sunset_hour;
 	uint8_t      sunset_min;
-	TextLayer   *main_time_layer;
-	TextLayer   *text_time_layer;
+	time_t       next_sun_change;       // next sunrise/sunset instant, 0 if not BACKGROUND_SUNS
+	bool         has_location;          // sun times are worked out here, not sent by the phone
+	int16_t      latitude;              // hundredths of a degree, as PBCOMM_LOCATION_KEY
+	int16_t      longitude;
+	int          sun_day;               // tm_yday + 1 the sun times are for, 0 to recompute
+	uint8_t      transition_count;
+	uint8_t      transitions[MAX_TRANSITIONS * TRANSITION_LEN];  // as PBCOMM_TRANSITIONS_KEY data
+	uint8_t      days_rolled;           // forecast days the worker dropped while the app was closed
+	GColor       text_color;
+	GColor       bg_color;
 	char         time_text[10];
-	TextLayer   *main_city_layer;
-	TextLayer   *text_city_layer;
-	TextLayer   *text_date_layer;
+	char         city[MAX_CITY_LEN];
+	uint8_t      sequence;              // last PBCOMM_UPDATE_KEY sequence number applied
+	uint8_t      changes;               // ZONE_CHANGED_* work left for commit_zone_changes()
+	bool         unsaved;               // changed since it was last written to persistent storage
+	uint8_t      icon[MAX_WEATHER_DAYS];
 	char         date_text[18];
-	char         time_format[12];
-	BitmapLayer *bitmap_weather_layer[MAX_WEATHER_DAYS];
-	TextLayer   *text_temp_layer[MAX_WEATHER_DAYS];
-    char         temps[MAX_WEATHER_DAYS][MAX_TEMPERATURE_LEN];
+	TimeStyle    time_style;
 } WatchFace;
 
 typedef struct {
@@ -53,48 +101,504 @@ typedef struct {
     char         version_text[24];
     TextLayer   *batterystatus;
     char         batt_text[20];
-    TextLayer   *weatherupdate[MAX_WATCH_FACES];
-    char         last_text[MAX_WATCH_FACES][20];
+    TextLayer   *weatherupdate[ROWS_PER_PAGE];
+    char         last_text[ROWS_PER_PAGE][20];
+#ifdef PERF_COUNTERS
+    TextLayer   *perf;                  // covers the rest while the perf page is shown
+    char         perf_text[320];
+#endif
 } Status;
 
 static Window     *mainwindow;
+static bool        mainwindow_visible = false;
 static WatchFace   watchfaces[MAX_WATCH_FACES];
+static int         zone_count = DEFAULT_WATCH_FACES;    // zones configured on the phone
+static Layer      *main_rows[ROWS_PER_PAGE];            // reused for every page of zones
+static uint8_t     main_row_redraw[ROWS_PER_PAGE];      // ROW_REDRAW_* for each row's next frame
+static int         main_page = 0;
 static Window     *statuswindow;
 static Status      status;
+static GBitmap    *weather_atlas;
 static GBitmap    *conditions[MAX_WEATHER_CONDITIONS];
 
+// Cell of each WEATHER_* icon in the weather atlas strip, see tools/build_atlas.py.
+// There's no sleet icon, so sleet shows as snow.
+#define WEATHER_ICON_SIZE 36
+static const uint8_t weather_atlas_cell[MAX_WEATHER_CONDITIONS] = {
+    0, 1, 2, 3, 4, 4, 5, 6, 7, 8, 9
+};
+
 AppTimer          *statuswindow_timer;
+static AppTimer   *sun_timer = NULL;
+static time_t      sun_timer_due = 0;       // when sun_timer fires, 0 if it isn't set
+static AppTimer   *persist_timer = NULL;
+static AppTimer   *request_timer = NULL;
+static uint8_t     request_pending = 0;     // request to resend if the phone wasn't ready
+static bool        request_fresh = false;   // request_pending hasn't gone out yet, it needs an ID
+static int         request_retries = 0;
+static time_t      last_request_time = 0;   // when we last asked the phone for data
+
+// Where a refresh spends its time. The two clocks aren't synchronized, so the trip back is
+// what's left of the round trip after the trip out and the phone's own time.
+typedef enum {
+    STAGE_BT_OUT,                           // request sent to ACK
+    STAGE_GEOLOCATION,
+    STAGE_HTTP,
+    STAGE_BT_BACK,
+    NUM_STAGES
+} RequestStage;
+
+
+static struct {
+    uint16_t     id;                        // of the last request, echoed back by the phone
+    time_t       sent_secs;                 // when it last went out
+    uint16_t     sent_ms;
+    uint32_t     bt_out_ms;
+    AppTimer    *timeout;                   // set while waiting for the reply
+    uint32_t     timeouts;
+    uint16_t     histogram[NUM_STAGES][LATENCY_BUCKETS];
+} request_timing;
+static bool        phone_connected = true;
+static BatteryChargeState battery;
+static DetailView *detail = NULL;           // NULL until a detail window is first pushed
+static bool        launch_worker = false;   // start the background worker when the app closes
+static AppTimer   *detail_timer = NULL;     // frees the detail view once it's been idle
 
 int current_window = 0;
 int temp_display   = 0;
-static char time_12h_format[9] = "%I:%M %p";
-static char time_24h_format[6] = "%Hh%M";
+
+// Relative costs for the energy score, defined in every build so the host simulator scores
+// the shipping build the same way. They only rank builds against each other: a wakeup is the
+// unit, a redraw touches the whole frame buffer and the radio dwarfs everything else.
+#define PERF_COST_WAKEUP        1
+#define PERF_COST_TIME_CALL     1           // per localtime() or strftime()
+#define PERF_COST_REDRAW        20          // per layer_mark_dirty()
+#define PERF_COST_MESSAGE       200         // per AppMessage either way
+#define PERF_COST_BYTE          1           // per AppMessage byte either way
+
+#ifdef PERF_COUNTERS
+typedef enum {
+    PERF_MINUTE_TICK,
+    PERF_UPDATE_TIME,
+    PERF_UPDATE_BACKGROUND,
+    PERF_UPDATE_TEMPS,
+    PERF_INBOX_RECEIVED,
+    PERF_SHOW_DETAIL,
+    PERF_NUM_PATHS
+} PerfPath;
+
+typedef struct {
+    uint32_t     calls;
+    uint32_t     total_ms;
+    uint32_t     max_ms;
+    uint32_t     dirty_marks;
+    int32_t      heap_delta;
+} PerfCounter;
+
+typedef struct {
+    time_t       secs;
+    uint16_t     ms;
+    uint32_t     dirty_marks;
+    size_t       heap_used;
+} PerfSample;
+
+static const char *perf_names[PERF_NUM_PATHS] = {
+    "handle_minute_tick", "update_time", "update_background", "update_temps",
+    "inbox_received_callback", "show_detail"
+};
+static const char *perf_labels[PERF_NUM_PATHS] = {   // for the status page
+    "tick", "time", "bg", "temps", "inbox", "push"
+};
+static PerfCounter perf[PERF_NUM_PATHS];
+static uint32_t    perf_dirty_marks = 0;
+
+// Whole-run totals. perf_started is set at init, so rates can be worked out per day.
+typedef struct {
+    time_t       started;
+    uint32_t     localtime_calls;
+    uint32_t     strftime_calls;
+    uint32_t     messages_in;
+    uint32_t     bytes_in;
+    uint32_t     messages_out;
+    uint32_t     bytes_out;
+    uint32_t     inbox_dropped;
+    uint32_t     outbox_failed;
+} PerfTotals;
+
+static PerfTotals perf_totals;
+
+static void perf_layer_mark_dirty(Layer *layer) {
+    perf_dirty_marks++;
+    layer_mark_dirty(layer);
+}
+#define layer_mark_dirty(layer) perf_layer_mark_dirty(layer)
+
+static struct tm *perf_localtime(const time_t *timep) {
+    perf_totals.localtime_calls++;
+    return localtime(timep);
+}
+#define localtime(timep) perf_localtime(timep)
+
+static int perf_strftime(char *s, size_t max, const char *fmt, const struct tm *tm) {
+    perf_totals.strftime_calls++;
+    return strftime(s, max, fmt, tm);
+}
+#define strftime(s, max, fmt, tm) perf_strftime(s, max, fmt, tm)
+
+// Each tuple is a 7 byte header (key, type, length) plus its value, after a 1 byte count.
+static void perf_message_in(DictionaryIterator *iter) {
+    perf_totals.messages_in++;
+    perf_totals.bytes_in++;
+    for (Tuple *tuple = dict_read_first(iter); tuple != NULL; tuple = dict_read_next(iter)) {
+        perf_totals.bytes_in += 7 + tuple->length;
+    }
+}
+
+static void perf_message_out(uint32_t bytes) {
+    perf_totals.messages_out++;
+    perf_totals.bytes_out += bytes;
+}
+
+static void perf_begin(PerfSample *sample) {
+    sample->ms = time_ms(&sample->secs, NULL);
+    sample->dirty_marks = perf_dirty_marks;
+    sample->heap_used = heap_bytes_used();
+}
+
+static void perf_end(PerfPath path, PerfSample *sample) {
+    time_t   secs;
+    uint16_t ms = time_ms(&secs, NULL);
+    uint32_t elapsed = (uint32_t)((secs - sample->secs) * 1000 + ms - sample->ms);
+
+    perf[path].calls++;
+    perf[path].total_ms += elapsed;
+    if (elapsed > perf[path].max_ms) {
+        perf[path].max_ms = elapsed;
+    }
+    perf[path].dirty_marks += perf_dirty_marks - sample->dirty_marks;
+    perf[path].heap_delta += (int32_t)(heap_bytes_used() - sample->heap_used);
+}
+
+/*
+ * Writes a summary of the counters into buf for the status window's perf page
+ */
+static void perf_format(char *buf, size_t size) {
+    int len = 0;
+    for (int i = 0; (i < PERF_NUM_PATHS) && (len < (int)size); i++) {
+        len += snprintf(buf + len, size - len, "%s %d  avg %d max %d ms\n", perf_labels[i],
+                        (int)perf[i].calls,
+                        (int)(perf[i].calls ? perf[i].total_ms / perf[i].calls : 0),
+                        (int)perf[i].max_ms);
+    }
+    if (len < (int)size) {
+        len += snprintf(buf + len, size - len, "msgs in %d drop %d\nout %d fail %d\n",
+                        (int)perf_totals.messages_in, (int)perf_totals.inbox_dropped,
+                        (int)perf_totals.messages_out, (int)perf_totals.outbox_failed);
+    }
+    if (len < (int)size) {
+        snprintf(buf + len, size - len, "heap used %d free %d",
+                 (int)heap_bytes_used(), (int)heap_bytes_free());
+    }
+}
+
+static void perf_dump(void) {
+    for (int i = 0; i < PERF_NUM_PATHS; i++) {
+        if (perf[i].calls == 0) {
+            continue;
+        }
+        APP_LOG(APP_LOG_LEVEL_DEBUG,
+            "%s: calls: %d, ms/op: %d.%02d, max ms: %d, dirty/op: %d.%02d, heap/op: %d",
+            perf_names[i], (int)perf[i].calls,
+            (int)(perf[i].total_ms / perf[i].calls), (int)((perf[i].total_ms * 100 / perf[i].calls) % 100),
+            (int)perf[i].max_ms,
+            (int)(perf[i].dirty_marks / perf[i].calls), (int)((perf[i].dirty_marks * 100 / perf[i].calls) % 100),
+            (int)(perf[i].heap_delta / (int32_t)perf[i].calls));
+    }
+
+    uint32_t redraws = 0;
+    for (int i = 0; i < PERF_NUM_PATHS; i++) {
+        redraws += perf[i].dirty_marks;
+    }
+    uint32_t energy = perf[PERF_MINUTE_TICK].calls * PERF_COST_WAKEUP +
+                      (perf_totals.localtime_calls + perf_totals.strftime_calls) * PERF_COST_TIME_CALL +
+                      redraws * PERF_COST_REDRAW +
+                      (perf_totals.messages_in + perf_totals.messages_out) * PERF_COST_MESSAGE +
+                      (perf_totals.bytes_in + perf_totals.bytes_out) * PERF_COST_BYTE;
+    uint32_t minutes = (uint32_t)(time(NULL) - perf_totals.started) / 60;
+    APP_LOG(APP_LOG_LEVEL_DEBUG,
+        "totals over %d min: ticks: %d, localtime: %d, strftime: %d, redraws: %d",
+        (int)minutes, (int)perf[PERF_MINUTE_TICK].calls, (int)perf_totals.localtime_calls,
+        (int)perf_totals.strftime_calls, (int)redraws);
+    APP_LOG(APP_LOG_LEVEL_DEBUG,
+        "messages in: %d (%d bytes), out: %d (%d bytes), energy: %d, per day: %d",
+        (int)perf_totals.messages_in, (int)perf_totals.bytes_in,
+        (int)perf_totals.messages_out, (int)perf_totals.bytes_out,
+        (int)energy, (int)(minutes ? (uint64_t)energy * 1440 / minutes : 0));
+    APP_LOG(APP_LOG_LEVEL_DEBUG,
+        "inbox dropped: %d, outbox failed: %d, heap used: %d, free: %d",
+        (int)perf_totals.inbox_dropped, (int)perf_totals.outbox_failed,
+        (int)heap_bytes_used(), (int)heap_bytes_free());
+}
+
+#define PERF_BEGIN()     PerfSample perf_sample; perf_begin(&perf_sample)
+#define PERF_END(path)   perf_end(path, &perf_sample)
+#define PERF_MESSAGE_IN(iter)    perf_message_in(iter)
+#define PERF_MESSAGE_OUT(bytes)  perf_message_out(bytes)
+#define PERF_COUNT(total)        perf_totals.total++
+#else
+#define PERF_BEGIN()
+#define PERF_END(path)
+#define PERF_MESSAGE_IN(iter)
+#define PERF_MESSAGE_OUT(bytes)  (void)(bytes)
+#define PERF_COUNT(total)
+#endif
+
+// Log sites below EVENT_LOG_LEVEL are compiled out. Aplite is short of room, so it only
+// keeps errors and warnings unless built with a different EVENT_LOG_LEVEL.
+#ifndef EVENT_LOG_LEVEL
+#ifdef PBL_PLATFORM_APLITE
+#define EVENT_LOG_LEVEL     EVENT_LEVEL_WARNING
+#else
+#define EVENT_LOG_LEVEL     EVENT_LEVEL_DEBUG
+#endif
+#endif
+
+#if EVENT_LOG_LEVEL >= EVENT_LEVEL_ERROR
+#define LOG_ERROR(event, a, b)      event_log(EVENT_LEVEL_ERROR, event, a, b)
+#else
+#define LOG_ERROR(event, a, b)
+#endif
+#if EVENT_LOG_LEVEL >= EVENT_LEVEL_WARNING
+#define LOG_WARNING(event, a, b)    event_log(EVENT_LEVEL_WARNING, event, a, b)
+#else
+#define LOG_WARNING(event, a, b)
+#endif
+#if EVENT_LOG_LEVEL >= EVENT_LEVEL_INFO
+#define LOG_INFO(event, a, b)       event_log(EVENT_LEVEL_INFO, event, a, b)
+#else
+#define LOG_INFO(event, a, b)
+#endif
+#if EVENT_LOG_LEVEL >= EVENT_LEVEL_DEBUG
+#define LOG_DEBUG(event, a, b)      event_log(EVENT_LEVEL_DEBUG, event, a, b)
+#else
+#define LOG_DEBUG(event, a, b)
+#endif
+
+// Packs four bytes into an event's B argument, first byte lowest
+#define LOG_BYTES(b0, b1, b2, b3)   ((int32_t)((uint32_t)(uint8_t)(b0)         | \
+                                               ((uint32_t)(uint8_t)(b1) << 8)  | \
+                                               ((uint32_t)(uint8_t)(b2) << 16) | \
+                                               ((uint32_t)(uint8_t)(b3) << 24)))
+
+#define EVENT_LOG_SIZE      32              // records kept, the oldest are overwritten
+
+// Same layout as a PBCOMM_LOG_KEY record, so records go out as they are
+typedef struct {
+    uint32_t     time;
+    uint8_t      event;
+    uint8_t      level;
+    int16_t      a;
+    int32_t      b;
+} LogRecord;
+
+static LogRecord   event_log_records[EVENT_LOG_SIZE];
+static int         event_log_first = 0;     // oldest record
+static int         event_log_count = 0;
+static int         event_log_sending = 0;   // oldest records in the outbox, dropped once sent
+
+// What the message in the outbox is, so its ACK or failure goes to the right place
+typedef enum {
+    OUTBOX_EMPTY,
+    OUTBOX_REQUEST,
+    OUTBOX_LOG
+} OutboxContents;
+
+static OutboxContents outbox_contents = OUTBOX_EMPTY;
+
+/*
+ * Records an event. Nothing is formatted here; the phone does that when the log is flushed.
+ */
+static void event_log(uint8_t level, uint8_t event, int16_t a, int32_t b) {
+    LogRecord *record = &event_log_records[(event_log_first + event_log_count) % EVENT_LOG_SIZE];
+
+    if (event_log_count < EVENT_LOG_SIZE) {
+        event_log_count++;
+    } else {
+        event_log_first = (event_log_first + 1) % EVENT_LOG_SIZE;
+        if (event_log_sending > 0) {
+            event_log_sending--;            // it's in the outbox already, don't drop it twice
+        }
+    }
+    record->time  = (uint32_t)time(NULL);
+    record->event = event;
+    record->level = level;
+    record->a     = a;
+    record->b     = b;
+}
+
+/*
+ * Sends every record to the phone, unless a send is already under way
+ */
+static void event_log_flush(void) {
+    uint8_t data[EVENT_LOG_SIZE * LOG_RECORD_LEN];
+    DictionaryIterator *iter;
+
+    if ((event_log_count == 0) || (outbox_contents != OUTBOX_EMPTY)) {
+        return;
+    }
+    if ((app_message_outbox_begin(&iter) != APP_MSG_OK) || (iter == NULL)) {
+        return;
+    }
+    for (int i = 0; i < event_log_count; i++) {
+        memcpy(&data[i * LOG_RECORD_LEN],
+               &event_log_records[(event_log_first + i) % EVENT_LOG_SIZE], LOG_RECORD_LEN);
+    }
+    dict_write_data(iter, PBCOMM_LOG_KEY, data, event_log_count * LOG_RECORD_LEN);
+    PERF_MESSAGE_OUT(dict_write_end(iter));
+    event_log_sending = event_log_count;
+    outbox_contents = OUTBOX_LOG;
+    app_message_outbox_send();
+}
+
+static void event_log_sent(void) {
+    event_log_first = (event_log_first + event_log_sending) % EVENT_LOG_SIZE;
+    event_log_count -= event_log_sending;
+    event_log_sending = 0;
+}
 
 uint8_t weather[] = {(uint8_t)WEATHER_UNKNOWN, (uint8_t)WEATHER_UNKNOWN, (uint8_t)WEATHER_UNKNOWN,
                      (uint8_t)-99, (uint8_t)-10, (uint8_t)0, (uint8_t)100,
                                    (uint8_t)-11, (uint8_t)1, (uint8_t)101, 
                      (uint8_t)0, (uint8_t)0, (uint8_t)12, (uint8_t)0 };
 
-static void request_update_from_phone(void) {
-    Tuplet value = TupletInteger(1, 1);
+
+// What each watchface shows until the phone sends real data. Zones past the defaults start
+// out blank and are only shown once the phone configures them.
+static const struct {
+    int32_t      gmt_sec_offset;
+    uint8_t      display;
+    const char  *city;
+} zone_defaults[MAX_WATCH_FACES] = {
+    { -28800, DISPLAY_WATCH_CONFIG_TIME, "Watch Time"      },
+    {      0, DISPLAY_24_HOUR_TIME,      "London, England" },
+    {  32400, DISPLAY_24_HOUR_TIME,      "Tokyo, Japan"    }
+};
+
+static uint16_t read_uint16(const uint8_t *data) {
+    return (uint16_t)(data[0] | ((uint16_t)data[1] << 8));
+}
+
+static uint32_t elapsed_ms(time_t secs, uint16_t ms) {
+    time_t   now_secs;
+    uint16_t now_ms = time_ms(&now_secs, NULL);
+    return (uint32_t)((now_secs - secs) * 1000 + now_ms - ms);
+}
+
+static void record_latency(RequestStage stage, uint32_t ms) {
+    int bucket = 0;
+    for (uint32_t limit = LATENCY_FIRST_MS; (bucket < LATENCY_BUCKETS - 1) && (ms >= limit); limit *= 2) {
+        bucket++;
+    }
+    if (request_timing.histogram[stage][bucket] < UINT16_MAX) {
+        request_timing.histogram[stage][bucket]++;
+    }
+}
+
+static void request_timeout_callback(void *data) {
+    request_timing.timeout = NULL;
+    request_timing.timeouts++;
+    LOG_WARNING(EVENT_REQUEST_TIMEOUT, request_timing.id, 0);
+}
+
+/*
+ * Records the stages of the request the phone says it's answering, unless that isn't the
+ * one we're waiting on
+ */
+static void apply_timing(const uint8_t *data, uint16_t length) {
+    if ((length < TIMING_LEN) || (request_timing.timeout == NULL) ||
+        (read_uint16(data + TIMING_REQUEST_ID) != request_timing.id)) {
+        return;
+    }
+    uint32_t total = elapsed_ms(request_timing.sent_secs, request_timing.sent_ms);
+    uint32_t phone = read_uint16(data + TIMING_PHONE);
+    uint32_t geo   = read_uint16(data + TIMING_GEOLOCATION);
+    uint32_t http  = read_uint16(data + TIMING_HTTP);
+
+    app_timer_cancel(request_timing.timeout);
+    request_timing.timeout = NULL;
+    record_latency(STAGE_BT_OUT, request_timing.bt_out_ms);
+    if (geo != 0) {
+        record_latency(STAGE_GEOLOCATION, geo);
+    }
+    if (http != 0) {
+        record_latency(STAGE_HTTP, http);
+    }
+    record_latency(STAGE_BT_BACK, (total > request_timing.bt_out_ms + phone) ?
+                                  total - request_timing.bt_out_ms - phone : 0);
+}
+
+#if EVENT_LOG_LEVEL >= EVENT_LEVEL_DEBUG
+/*
+ * Logs the latency histograms for the phone to print: the timeouts, then each pair of buckets
+ * that isn't empty
+ */
+static void latency_dump(void) {
+    LOG_DEBUG(EVENT_LATENCY, (request_timing.timeouts < INT16_MAX) ? request_timing.timeouts : INT16_MAX,
+              LATENCY_FIRST_MS);
+    for (int i = 0; i < NUM_STAGES; i++) {
+        uint16_t *h = request_timing.histogram[i];
+        for (int b = 0; b < LATENCY_BUCKETS; b += 2) {
+            if ((h[b] != 0) || (h[b+1] != 0)) {
+                LOG_DEBUG(EVENT_LATENCY_BUCKETS, (i << 8) | b, (int32_t)(h[b] | ((uint32_t)h[b+1] << 16)));
+            }
+        }
+    }
+}
+#endif
+
+/*
+ * Sends a request, or leaves it pending if the outbox is busy. A new request only takes its ID
+ * and starts its timeout once it's actually sent, so a reply to the one before isn't mistaken
+ * for its own.
+ */
+static void send_request(uint8_t request) {
+    Tuplet value = TupletInteger(PBCOMM_REQUEST_KEY, request);
     DictionaryIterator *iter;
-    app_message_outbox_begin(&iter);
-    if (iter == NULL) {
+    request_pending = request;
+    if ((app_message_outbox_begin(&iter) != APP_MSG_OK) || (iter == NULL)) {
         return;
     }
+    if (request_fresh) {
+        request_fresh = false;
+        request_timing.id++;
+        request_timing.bt_out_ms = 0;
+        if (request_timing.timeout != NULL) {
+            app_timer_reschedule(request_timing.timeout, REQUEST_TIMEOUT_MS);
+        } else {
+            request_timing.timeout = app_timer_register(REQUEST_TIMEOUT_MS, request_timeout_callback, NULL);
+        }
+    }
     dict_write_tuplet(iter, &value);
-    dict_write_end(iter);
+    dict_write_uint16(iter, PBCOMM_REQUEST_ID_KEY, request_timing.id);
+    PERF_MESSAGE_OUT(dict_write_end(iter));
+    request_timing.sent_ms = time_ms(&request_timing.sent_secs, NULL);
+    outbox_contents = OUTBOX_REQUEST;
     app_message_outbox_send();
+    LOG_INFO(EVENT_REQUEST_SENT, request_timing.id, request);
 }
 
-bool is_sunrise (struct tm *local_time, WatchFace *wf) {
-    return ((local_time->tm_hour == wf->sunrise_hour ) &&
-            (local_time->tm_min  == wf->sunrise_min  )    );
+static void request_update_from_phone(uint8_t request) {
+    request_retries = 0;
+    last_request_time = time(NULL);
+    request_fresh = true;
+    send_request(request);
 }
 
-bool is_sunset (struct tm *local_time, WatchFace *wf) {
-    return ((local_time->tm_hour == wf->sunset_hour  ) &&
-            (local_time->tm_min  == wf->sunset_min   )    );
+void request_retry_callback(void *data) {
+    request_timer = NULL;
+    if (phone_connected) {
+        send_request(request_pending);
+    }
 }
 
 bool sunisup ( struct tm *local_time, int sunrise_hour, int sunrise_min,
@@ -108,35 +612,413 @@ bool sunisup ( struct tm *local_time, int sunrise_hour, int sunrise_min,
              (local_time->tm_min < sunset_min)       )  )  );
 }
 
+// The watch's own local time, converted at most once a second and shared by every zone. The
+// minute tick hands over its broken-down time, so a tick needs no conversion at all.
+static struct {
+    time_t       secs;                      // UTC time tm is for
+    struct tm    tm;
+} clock_ref;
+
+static const struct tm *reference_time(time_t now) {
+    if (now != clock_ref.secs) {
+        clock_ref.tm = *localtime(&now);
+        clock_ref.secs = now;
+    }
+    return &clock_ref.tm;
+}
+
+// Days from 1970-01-01 to a broken-down date
+static int days_since_epoch(const struct tm *t) {
+    int y = t->tm_year;
+    return (365 * (y - 70)) + ((y - 69) / 4) - ((y - 1) / 100) + ((y + 299) / 400) + t->tm_yday;
+}
+
+// Sunrise/sunset from the zone's position, in Pebble trig units (TRIG_MAX_ANGLE is a full
+// turn, TRIG_MAX_RATIO is 1). The sun counts as up once its centre is 0.833 degrees below
+// the horizon, allowing for refraction and its radius.
+#define SUN_HORIZON_SIN     (-953)          // sin(-0.833 degrees)
+#define MINUTES_PER_DAY     1440
+
+static int32_t trig_angle_from_centidegrees(int32_t centidegrees) {
+    int32_t angle = centidegrees * (TRIG_MAX_ANGLE / 16) / (36000 / 16);
+    return (angle + TRIG_MAX_ANGLE) % TRIG_MAX_ANGLE;
+}
+
+/*
+ * The angle in [0, TRIG_MAX_ANGLE / 2] whose cosine is ratio, by binary search since the
+ * SDK has no acos
+ */
+static int32_t acos_lookup(int32_t ratio) {
+    int32_t lo = 0;
+    int32_t hi = TRIG_MAX_ANGLE / 2;
+
+    while (lo < hi) {
+        int32_t mid = (lo + hi) / 2;
+        if (cos_lookup(mid) > ratio) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static int32_t clamp_minutes(int32_t minutes) {
+    return (minutes < 0) ? 0 : (minutes > MINUTES_PER_DAY) ? MINUTES_PER_DAY : minutes;
+}
+
+static void set_sun_minutes(WatchFace *wf, int32_t rise, int32_t set) {
+    wf->sunrise_hour = rise / 60;
+    wf->sunrise_min  = rise % 60;
+    wf->sunset_hour  = set / 60;
+    wf->sunset_min   = set % 60;
+}
+
+/*
+ * Works out the zone's sunrise and sunset for the local day from its position, at most once
+ * a day. Uses the NOAA fractional-year series for declination and the equation of time,
+ * within a couple of minutes of the full NOAA calculation outside the polar circles. With no
+ * sunrise both times are 24:00, so the sun is never up; with no sunset they're 0:00 and
+ * 24:00, so it always is. A sunrise or sunset that falls on the day before or after, as
+ * around midsummer in Reykjavik, is held at 0:00 or 24:00 of this one.
+ */
+void update_sun_times(WatchFace *wf, const struct tm *local_time) {
+    int32_t day = local_time->tm_yday;      // 0 is January 1st
+
+    if (!wf->has_location || (wf->sun_day == day + 1)) {
+        return;
+    }
+    wf->sun_day = day + 1;
+
+    // Fractional year at local noon, and its multiples, as the series uses them
+    int32_t year_days = ((local_time->tm_year % 4) == 0) ? 366 : 365;
+    int32_t g = TRIG_MAX_ANGLE * day / year_days;
+    int64_t cos1 = cos_lookup(g), sin1 = sin_lookup(g);
+    int64_t cos2 = cos_lookup((2 * g) % TRIG_MAX_ANGLE), sin2 = sin_lookup((2 * g) % TRIG_MAX_ANGLE);
+    int64_t cos3 = cos_lookup((3 * g) % TRIG_MAX_ANGLE), sin3 = sin_lookup((3 * g) % TRIG_MAX_ANGLE);
+
+    // Declination in tenths of a trig unit
+    int64_t decl10 = 722 * TRIG_MAX_RATIO - 41712 * cos1 + 7328 * sin1 - 705 * cos2 + 95 * sin2 -
+                     281 * cos3 + 154 * sin3;
+    int32_t decl = (int32_t)(decl10 / (10 * TRIG_MAX_RATIO));
+    decl = (decl + TRIG_MAX_ANGLE) % TRIG_MAX_ANGLE;
+    int32_t lat = trig_angle_from_centidegrees(wf->latitude);
+
+    // cos(hour angle) at sunrise = (sin(h0) - sin(lat) sin(decl)) / (cos(lat) cos(decl))
+    int32_t num = SUN_HORIZON_SIN -
+                  (int32_t)((int64_t)sin_lookup(lat) * sin_lookup(decl) / TRIG_MAX_RATIO);
+    int32_t den = (int32_t)((int64_t)cos_lookup(lat) * cos_lookup(decl) / TRIG_MAX_RATIO);
+    if (num >= den) {
+        set_sun_minutes(wf, MINUTES_PER_DAY, MINUTES_PER_DAY);
+        return;
+    }
+    if (num <= -den) {
+        set_sun_minutes(wf, 0, MINUTES_PER_DAY);
+        return;
+    }
+    int32_t half_day = acos_lookup((int32_t)((int64_t)num * TRIG_MAX_RATIO / den)) *
+                       MINUTES_PER_DAY / TRIG_MAX_ANGLE;
+
+    // Equation of time in hundredths of a minute
+    int32_t eot = (int32_t)((2 * TRIG_MAX_RATIO + 43 * cos1 - 735 * sin1 - 335 * cos2 - 936 * sin2) /
+                            TRIG_MAX_RATIO);
+
+    // Solar noon, moved from UTC into the zone, four minutes to each degree of longitude
+    int32_t noon = (MINUTES_PER_DAY / 2) - (wf->longitude * 4 + eot) / 100 + wf->gmt_sec_offset / 60;
+    set_sun_minutes(wf, clamp_minutes(noon - half_day), clamp_minutes(noon + half_day));
+}
+
+static const char digit_pairs[] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+static const char day_names[]   = "SunMonTueWedThuFriSat";
+static const char month_names[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+
+/*
+ * Stores a character only if it differs from what's already there, and notes the change.
+ */
+static inline void format_put(char *text, int pos, char c, bool *changed) {
+    if (text[pos] != c) {
+        text[pos] = c;
+        *changed = true;
+    }
+}
+
+static inline void format_put_pair(char *text, int pos, int value, bool *changed) {
+    format_put(text, pos,     digit_pairs[value * 2],     changed);
+    format_put(text, pos + 1, digit_pairs[value * 2 + 1], changed);
+}
+
+/*
+ * Writes the time as "9:05 AM" (12-hour, no leading zero) or "09h05" (24-hour), touching only
+ * the characters that differ from the text already in the buffer (at least 9 bytes). Returns
+ * true if the text changed.
+ */
+bool format_time(char *text, TimeStyle style, const struct tm *t) {
+    bool result = false;
+    int pos = 0;
+
+    if (style == TIME_STYLE_24H) {
+        format_put_pair(text, pos, t->tm_hour, &result);
+        format_put(text, pos + 2, 'h', &result);
+        format_put_pair(text, pos + 3, t->tm_min, &result);
+        pos += 5;
+    } else {
+        int hour = t->tm_hour % 12;
+        if (hour == 0) {
+            hour = 12;
+        }
+        if (hour >= 10) {
+            format_put(text, pos++, '1', &result);
+        }
+        format_put(text, pos++, digit_pairs[hour * 2 + 1], &result);
+        format_put(text, pos++, ':', &result);
+        format_put_pair(text, pos, t->tm_min, &result);
+        pos += 2;
+        format_put(text, pos++, ' ', &result);
+        format_put(text, pos++, (t->tm_hour < 12) ? 'A' : 'P', &result);
+        format_put(text, pos++, 'M', &result);
+    }
+    format_put(text, pos, '\0', &result);
+    return result;
+}
+
+/*
+ * Writes the date as "Sat Oct  3, 2015" (the same as strftime's "%a %b %e, %Y") into a buffer
+ * of at least 17 bytes, touching only the characters that changed. Returns true if any did.
+ */
+bool format_date(char *text, const struct tm *t) {
+    bool result = false;
+    int year = t->tm_year + 1900;
+
+    for (int i = 0; i < 3; i++) {
+        format_put(text, i,     day_names[(t->tm_wday * 3) + i],  &result);
+        format_put(text, i + 4, month_names[(t->tm_mon * 3) + i], &result);
+    }
+    format_put(text, 3, ' ', &result);
+    format_put(text, 7, ' ', &result);
+    format_put(text, 8, (t->tm_mday < 10) ? ' ' : digit_pairs[t->tm_mday * 2], &result);
+    format_put(text, 9, digit_pairs[t->tm_mday * 2 + 1], &result);
+    format_put(text, 10, ',', &result);
+    format_put(text, 11, ' ', &result);
+    format_put_pair(text, 12, year / 100, &result);
+    format_put_pair(text, 14, year % 100, &result);
+    format_put(text, 16, '\0', &result);
+    return result;
+}
+
+TimeStyle time_style_for_display(int display) {
+    switch (display) {
+        case DISPLAY_WATCH_CONFIG_TIME:
+            return clock_is_24h_style() ? TIME_STYLE_24H : TIME_STYLE_12H;
+        case DISPLAY_12_HOUR_TIME:
+            return TIME_STYLE_12H;
+        case DISPLAY_24_HOUR_TIME:
+        default:
+            return TIME_STYLE_24H;
+    }
+}
+
+/*
+ * True when the detail view exists and is bound to this watchface
+ */
+static inline bool detail_shows(WatchFace *wf) {
+    return (detail != NULL) && (detail->zone == wf);
+}
+
+static inline int zone_index(const WatchFace *wf) {
+    return wf - watchfaces;
+}
+
+/*
+ * True when the zone's row is on the main window's current page
+ */
+static inline bool zone_on_page(const WatchFace *wf) {
+    return (zone_index(wf) / ROWS_PER_PAGE) == main_page;
+}
+
+/*
+ * True when the zone is drawn somewhere that's topmost: its row on the main window, or the
+ * detail window
+ */
+static inline bool zone_on_screen(const WatchFace *wf) {
+    return (mainwindow_visible && zone_on_page(wf)) || wf->visible;
+}
+
+#define VIEW_MAIN       0x01            // the zone's row on the main window
+#define VIEW_DETAIL     0x02            // the detail window, if it's showing the zone
+#define VIEW_MAIN_TIME  0x04            // just the time in the zone's main window row
+
+// What a main window row draws in its next frame. The frame buffer keeps the last frame, so a
+// row with nothing to redraw is left alone and a new time only repaints the time's box.
+#define ROW_REDRAW_TIME 0x01
+#define ROW_REDRAW_ALL  0x02
+#define ROW_TIME_BOX    GRect(0, 0, 144, 32)
+
+/*
+ * Marks the views that show a watchface for redraw. Only call this when a value actually
+ * changed, since each mark redraws the whole window.
+ */
+void mark_zone_dirty(WatchFace *wf, uint8_t views) {
+    if ((views & (VIEW_MAIN | VIEW_MAIN_TIME)) && zone_on_page(wf)) {
+        int r = zone_index(wf) % ROWS_PER_PAGE;
+        main_row_redraw[r] |= (views & VIEW_MAIN) ? ROW_REDRAW_ALL : ROW_REDRAW_TIME;
+        layer_mark_dirty(main_rows[r]);
+    }
+    if ((views & VIEW_DETAIL) && detail_shows(wf)) {
+        layer_mark_dirty(detail->layer);
+    }
+}
+
+/*
+ * Marks every main window row for a full redraw, when the page or the zone count changes
+ */
+static void mark_main_rows_dirty(void) {
+    for (int r = 0; r < ROWS_PER_PAGE; r++) {
+        main_row_redraw[r] = ROW_REDRAW_ALL;
+        layer_mark_dirty(main_rows[r]);
+    }
+}
+
+/*
+ * Draws one row of the main window's current page: a zone's time over its city, on the zone's
+ * background colour. Rows past the last zone are left blank. Only what main_row_redraw asks
+ * for is drawn; the rest of the row is still on screen from an earlier frame.
+ */
+void main_row_update_proc(Layer *layer, GContext *ctx) {
+    int row = *(int *)layer_get_data(layer);
+    int zone = (main_page * ROWS_PER_PAGE) + row;
+    WatchFace *wf = &watchfaces[zone];
+    uint8_t redraw = main_row_redraw[row];
+
+    main_row_redraw[row] = 0;
+    if (zone >= zone_count) {
+        if (redraw & ROW_REDRAW_ALL) {
+            graphics_context_set_fill_color(ctx, GColorBlack);
+            graphics_fill_rect(ctx, layer_get_bounds(layer), 0, GCornerNone);
+        }
+        return;
+    }
+    if (redraw == 0) {
+        return;
+    }
+
+    graphics_context_set_fill_color(ctx, wf->bg_color);
+    graphics_fill_rect(ctx, (redraw & ROW_REDRAW_ALL) ? layer_get_bounds(layer) : ROW_TIME_BOX,
+                       0, GCornerNone);
+    graphics_context_set_text_color(ctx, wf->text_color);
+    graphics_draw_text(ctx, wf->time_text, big_bold_font, ROW_TIME_BOX,
+                       GTextOverflowModeWordWrap, GTextAlignmentCenter, NULL);
+    if (!(redraw & ROW_REDRAW_ALL)) {
+        return;
+    }
+    graphics_draw_text(ctx, wf->city, small_bold_font, GRect(0, 32, 144, 24),
+                       GTextOverflowModeWordWrap, GTextAlignmentCenter, NULL);
+}
+
+/*
+ * Draws the detail window for the bound zone in one pass: time, date, city, then a weather
+ * icon with temperatures below it for each forecast day
+ */
+void detail_update_proc(Layer *layer, GContext *ctx) {
+    WatchFace *wf = detail->zone;
+
+    graphics_context_set_fill_color(ctx, wf->bg_color);
+    graphics_fill_rect(ctx, layer_get_bounds(layer), 0, GCornerNone);
+    graphics_context_set_text_color(ctx, wf->text_color);
+    graphics_draw_text(ctx, wf->time_text, big_bold_font, GRect(0, 6, 144, 44),
+                       GTextOverflowModeWordWrap, GTextAlignmentCenter, NULL);
+    graphics_draw_text(ctx, wf->date_text, med_bold_font, GRect(0, 44, 144, 28),
+                       GTextOverflowModeWordWrap, GTextAlignmentCenter, NULL);
+    graphics_draw_text(ctx, wf->city, small_bold_font, GRect(0, 72, 146, 22),
+                       GTextOverflowModeWordWrap, GTextAlignmentCenter, NULL);
+
+    // The icons are drawn white on black, so invert them on a dark background
+    if (gcolor_equal(wf->bg_color, GColorWhite)) {
+        graphics_context_set_compositing_mode(ctx, GCompOpAssign);
+    } else {
+        graphics_context_set_compositing_mode(ctx, GCompOpAssignInverted);
+    }
+    for (int j = 0; j < MAX_WEATHER_DAYS; j++) {
+        GBitmap *icon = conditions[wf->icon[j]];
+        if (icon != NULL) {
+            GRect box = GRect(9+(j*(36+9)), 94, 36, 36);
+            GRect frame = gbitmap_get_bounds(icon);
+            grect_align(&frame, &box, GAlignCenter, true);
+            graphics_draw_bitmap_in_rect(ctx, icon, frame);
+        }
+        graphics_draw_text(ctx, detail->temps[j], small_bold_font, GRect(9+(j*(36+9)), 130, 36, 38),
+                           GTextOverflowModeWordWrap, GTextAlignmentCenter, NULL);
+    }
+}
+
+/*
+ * Returns the broken-down time in a watchface's zone. The hour, minute and second come from
+ * the reference time plus the zone's difference from watch 0, so any offset change, the
+ * watch's own included, shows at once. The date only goes through the full calendar
+ * conversion when the zone's day changes.
+ */
+struct tm *zone_time(WatchFace *wf, int32_t local_gmt_offset) {
+    time_t now = time(NULL);
+    const struct tm *ref = reference_time(now);
+    int32_t secs = (ref->tm_hour * 3600) + (ref->tm_min * 60) + ref->tm_sec +
+                   wf->gmt_sec_offset - local_gmt_offset;
+    int32_t day_shift = (secs >= 0) ? (secs / SECONDS_PER_DAY) :
+                                      -((SECONDS_PER_DAY - 1 - secs) / SECONDS_PER_DAY);
+    int zone_day = days_since_epoch(ref) + day_shift + 1;
+
+    if (zone_day != wf->zone_day) {
+        time_t zone_secs = (now - local_gmt_offset) + wf->gmt_sec_offset;
+        wf->zone_tm = *localtime(&zone_secs);
+        wf->zone_day = zone_day;
+        return &wf->zone_tm;
+    }
+    secs -= day_shift * SECONDS_PER_DAY;
+    wf->zone_tm.tm_hour = secs / 3600;
+    wf->zone_tm.tm_min  = (secs / 60) % 60;
+    wf->zone_tm.tm_sec  = secs % 60;
+    return &wf->zone_tm;
+}
+
 void update_temps(WatchFace *wf) {
     static char now_single_temp_format[10]   = "%d\nNow";
     static char high_single_temp_format[10]  = "%d\nHigh";
     static char low_single_temp_format[10]   = "%d\nLow";
     static char dual_temp_format[10]         = "%d\n%d";
 
+    // Only the zone in the detail window shows temperatures
+    if (!detail_shows(wf)) {
+        return;
+    }
+    PERF_BEGIN();
+
     for (int i=0; i<MAX_WEATHER_DAYS; i++) {
         if (i == 0) {
             switch(temp_display) {
                 case 0:
                 default:
-                    snprintf(wf->temps[i], MAX_TEMPERATURE_LEN, now_single_temp_format,
+                    snprintf(detail->temps[i], MAX_TEMPERATURE_LEN, now_single_temp_format,
                              wf->temp);
                     break;
                 case 1:
-                    snprintf(wf->temps[i], MAX_TEMPERATURE_LEN, high_single_temp_format,
+                    snprintf(detail->temps[i], MAX_TEMPERATURE_LEN, high_single_temp_format,
                              wf->hi_temp[i]);
                     break;
                 case 2:
-                    snprintf(wf->temps[i], MAX_TEMPERATURE_LEN, low_single_temp_format,
+                    snprintf(detail->temps[i], MAX_TEMPERATURE_LEN, low_single_temp_format,
                              wf->lo_temp[i]);
                     break;
             }
         } else {
-            snprintf(wf->temps[i], MAX_TEMPERATURE_LEN, dual_temp_format,
+            snprintf(detail->temps[i], MAX_TEMPERATURE_LEN, dual_temp_format,
                      wf->hi_temp[i], wf->lo_temp[i]);
         }
-        layer_mark_dirty((Layer *)wf->text_temp_layer[i]);
     }
+    mark_zone_dirty(wf, VIEW_DETAIL);
+    PERF_END(PERF_UPDATE_TEMPS);
 }
 
 void update_background(WatchFace *wf, int32_t local_gmt_offset) {
@@ -144,9 +1026,8 @@ void update_background(WatchFace *wf, int32_t local_gmt_offset) {
     GColor text_color;
     GColor bg_color;
     
-    time_t time_in_secs = time(NULL);
-    time_in_secs = (time_in_secs - local_gmt_offset) + wf->gmt_sec_offset;
-    struct tm *local_time = localtime(&time_in_secs);
+    PERF_BEGIN();
+    struct tm *local_time = zone_time(wf, local_gmt_offset);
 
     switch (wf->background) {
         case BACKGROUND_DARK:
@@ -168,6 +1049,7 @@ void update_background(WatchFace *wf, int32_t local_gmt_offset) {
 #endif
             break;
         case BACKGROUND_SUNS:
+            update_sun_times(wf, local_time);
             if (sunisup(local_time, wf->sunrise_hour, wf->sunrise_min,
                         wf->sunset_hour, wf->sunset_min)) {
 #ifdef PBL_COLOR
@@ -198,208 +1080,607 @@ void update_background(WatchFace *wf, int32_t local_gmt_offset) {
             break;
     }
   
-    text_layer_set_text_color(wf->main_time_layer, text_color);
-    text_layer_set_background_color(wf->main_time_layer, bg_color);
-    text_layer_set_text_color(wf->main_city_layer, text_color);
-    text_layer_set_background_color(wf->main_city_layer, bg_color);
-    
-    window_set_background_color(wf->window, bg_color);
-    text_layer_set_text_color(wf->text_time_layer, text_color);
-    text_layer_set_text_color(wf->text_date_layer, text_color);
-    text_layer_set_text_color(wf->text_city_layer, text_color);
-    
-    // update each of the weather icon spaces
-    for ( int j = 0; j < MAX_WEATHER_DAYS; j++ ) {
-        if (gcolor_equal(bg_color, GColorWhite)) {
-            bitmap_layer_set_compositing_mode(wf->bitmap_weather_layer[j], GCompOpAssign);
+    if (!gcolor_equal(text_color, wf->text_color) || !gcolor_equal(bg_color, wf->bg_color)) {
+        wf->text_color = text_color;
+        wf->bg_color = bg_color;
+        mark_zone_dirty(wf, VIEW_MAIN | VIEW_DETAIL);
+    }
+    PERF_END(PERF_UPDATE_BACKGROUND);
+}
+
+void update_time(WatchFace *wf, int32_t local_gmt_offset) {
+
+    PERF_BEGIN();
+    struct tm *local_time = zone_time(wf, local_gmt_offset);
+
+    if (format_time(wf->time_text, wf->time_style, local_time)) {
+        mark_zone_dirty(wf, VIEW_MAIN_TIME | VIEW_DETAIL);
+    }
+
+    // Update date only if needed
+    if ((wf->last_day   != local_time->tm_mday)  ||
+        (wf->last_month != local_time->tm_mon)   ||
+        (wf->last_year  != local_time->tm_year))    {
+        wf->last_day   = local_time->tm_mday;
+        wf->last_month = local_time->tm_mon;
+        wf->last_year  = local_time->tm_year;
+        if (format_date(wf->date_text, local_time)) {
+            mark_zone_dirty(wf, VIEW_DETAIL);
+        }
+    }
+    PERF_END(PERF_UPDATE_TIME);
+}
+
+/*
+ * Seconds from local_time until hour:min next comes around in the same zone.
+ */
+int32_t secs_until(const struct tm *local_time, int hour, int min) {
+    int32_t now  = (local_time->tm_hour * 3600) + (local_time->tm_min * 60) + local_time->tm_sec;
+    int32_t then = (hour * 3600) + (min * 60);
+    return (then > now) ? (then - now) : (then - now + SECONDS_PER_DAY);
+}
+
+void sun_timer_callback(void *data);
+
+/*
+ * Works out the next sunrise or sunset for every BACKGROUND_SUNS face and arms a single
+ * timer for the earliest one, so the background flips on time without checking every tick.
+ */
+void schedule_sun_changes() {
+    time_t now = time(NULL);
+    time_t earliest = 0;
+
+    for (int i=0; i<zone_count; i++) {
+        WatchFace *wf = &watchfaces[i];
+        if (wf->background != BACKGROUND_SUNS) {
+            wf->next_sun_change = 0;
+            continue;
+        }
+        struct tm *local_time = zone_time(wf, watchfaces[0].gmt_sec_offset);
+        update_sun_times(wf, local_time);
+        int32_t to_sunrise = secs_until(local_time, wf->sunrise_hour, wf->sunrise_min);
+        int32_t to_sunset  = secs_until(local_time, wf->sunset_hour, wf->sunset_min);
+        wf->next_sun_change = now + ((to_sunrise < to_sunset) ? to_sunrise : to_sunset);
+        if ((earliest == 0) || (wf->next_sun_change < earliest)) {
+            earliest = wf->next_sun_change;
+        }
+    }
+
+    if (earliest == 0) {
+        if (sun_timer != NULL) {
+            app_timer_cancel(sun_timer);
+            sun_timer = NULL;
+        }
+        sun_timer_due = 0;
+        return;
+    }
+    uint32_t timeout_ms = (uint32_t)(earliest - now) * 1000;
+    if ((sun_timer == NULL) || !app_timer_reschedule(sun_timer, timeout_ms)) {
+        sun_timer = app_timer_register(timeout_ms, sun_timer_callback, NULL);
+    }
+    sun_timer_due = earliest;
+}
+
+void sun_timer_callback(void *data) {
+    time_t now = time(NULL);
+
+    sun_timer = NULL;
+    sun_timer_due = 0;
+    for (int i=0; i<zone_count; i++) {
+        WatchFace *wf = &watchfaces[i];
+        if ((wf->next_sun_change != 0) && (wf->next_sun_change <= now)) {
+            if (zone_on_screen(wf)) {
+                update_background(wf, watchfaces[0].gmt_sec_offset);
+            } else {
+                wf->stale = true;
+            }
+        }
+    }
+    schedule_sun_changes();
+}
+
+/*
+ * Only faces that are on screen are redrawn. A face is on screen when its row is on the
+ * main window's current page or it's in the detail window, and that window is topmost;
+ * otherwise it's marked stale and refreshed when it appears.
+ */
+void update_watches() {
+    for (int i=0; i<zone_count; i++) {
+        if (zone_on_screen(&watchfaces[i])) {
+            update_time(&watchfaces[i], watchfaces[0].gmt_sec_offset);
         } else {
-            bitmap_layer_set_compositing_mode(wf->bitmap_weather_layer[j], GCompOpAssignInverted);
+            watchfaces[i].stale = true;
         }
-        layer_mark_dirty((Layer *)wf->bitmap_weather_layer[j]);
-        text_layer_set_text_color(wf->text_temp_layer[j], text_color);
-        layer_mark_dirty((Layer *)wf->text_temp_layer[j]);
     }
-    layer_mark_dirty((Layer *)wf->main_time_layer);
-    layer_mark_dirty((Layer *)wf->main_city_layer);
-    layer_mark_dirty((Layer *)wf->text_time_layer);
-    layer_mark_dirty((Layer *)wf->text_date_layer);
-    layer_mark_dirty((Layer *)wf->text_city_layer);
 }
 
-void update_time(WatchFace *wf, int32_t local_gmt_offset) {
+/*
+ * Catch up a face that missed minute ticks while hidden, including any sunrise/sunset
+ * background change that happened in the meantime.
+ */
+void refresh_if_stale(WatchFace *wf) {
+    if (wf->stale) {
+        wf->stale = false;
+        update_time(wf, watchfaces[0].gmt_sec_offset);
+        update_background(wf, watchfaces[0].gmt_sec_offset);
+    }
+}
+
+bool apply_transitions();
+void commit_zone_changes();
+void schedule_persist_zones();
+
+/*
+ * How old zone data may get before asking the phone for more. Stretched while the battery is
+ * low, unless it's charging.
+ */
+int32_t refresh_interval_secs() {
+    int32_t secs = MINUTES_BETWEEN_WEATHER_UPDATES * 60;
+
+    if (!battery.is_charging && !battery.is_plugged) {
+        if (battery.charge_percent <= CRITICAL_BATTERY_PERCENT) {
+            secs *= 4;
+        } else if (battery.charge_percent <= LOW_BATTERY_PERCENT) {
+            secs *= 2;
+        }
+    }
+    return secs;
+}
+
+/*
+ * When the stalest zone that's shown last heard from the phone
+ */
+time_t oldest_zone_update() {
+    time_t oldest = watchfaces[0].last_weather_update;
+    for (int i = 1; i < zone_count; i++) {
+        if (watchfaces[i].last_weather_update < oldest) {
+            oldest = watchfaces[i].last_weather_update;
+        }
+    }
+    return oldest;
+}
+
+/*
+ * Asks the phone for data once the stalest zone has used up its refresh interval. Any sync,
+ * scheduled or not, resets the deadline since it's measured from the zones' own update times.
+ * Nothing is asked while the phone is away, and an unanswered request isn't repeated until
+ * another interval has passed.
+ */
+void refresh_if_due(time_t now) {
+    int32_t interval = refresh_interval_secs();
+
+    if (!phone_connected ||
+        ((now - oldest_zone_update()) < interval) ||
+        ((now - last_request_time) < interval)) {
+        return;
+    }
+    request_update_from_phone(REQUEST_UPDATE);
+}
+
+void battery_handler(BatteryChargeState charge) {
+    battery = charge;
+}
+
+/*
+ * Catch up as soon as the phone comes back, unless the data is still recent
+ */
+void connection_handler(bool connected) {
+    phone_connected = connected;
+    if (connected && ((time(NULL) - oldest_zone_update()) >= RECONNECT_FRESH_SECS)) {
+        request_update_from_phone(REQUEST_UPDATE);
+    }
+}
+
+void handle_minute_tick(struct tm *t, TimeUnits units_changed) {
+    PERF_BEGIN();
+    clock_ref.tm = *t;
+    clock_ref.secs = time(NULL);
+    // Offset changes fall on whole minutes, so checking each tick flips them on time
+    if (apply_transitions()) {
+        commit_zone_changes();
+        schedule_persist_zones();
+    }
+    // Sunrise and sunset fall on whole minutes, so the colours change in this tick's redraw
+    // rather than in a frame of their own when the timer fires a moment later
+    if ((sun_timer != NULL) && (sun_timer_due <= clock_ref.secs)) {
+        app_timer_cancel(sun_timer);
+        sun_timer_callback(NULL);
+    }
+    update_watches();
+    refresh_if_due(time(NULL));
+    PERF_END(PERF_MINUTE_TICK);
+}
+
+// TODO: Error handling
+static void inbox_dropped_callback(AppMessageResult reason, void *context) {
+    (void) context;
+    PERF_COUNT(inbox_dropped);
+    LOG_WARNING(EVENT_INBOX_DROPPED, reason, 0);
+}
+
+static void outbox_sent_callback(DictionaryIterator *iter, void *context) {
+    OutboxContents sent = outbox_contents;
+
+    outbox_contents = OUTBOX_EMPTY;
+    if (sent == OUTBOX_LOG) {
+        // A request made while the log was going out couldn't be sent, so send it now
+        event_log_sent();
+        if ((request_pending != 0) && (request_timer == NULL)) {
+            send_request(request_pending);
+        }
+        return;
+    }
+    request_pending = 0;
+    request_fresh = false;
+    request_retries = 0;
+    if (request_timing.timeout != NULL) {
+        request_timing.bt_out_ms = elapsed_ms(request_timing.sent_secs, request_timing.sent_ms);
+    }
+}
+
+/*
+ * The phone side may not be running yet, e.g. right after launch, so give a request a few
+ * more tries before waiting for the next scheduled one. That includes a request that was
+ * waiting behind a log that failed to go out.
+ */
+static void outbox_failed_callback(DictionaryIterator *iter, AppMessageResult reason, void *context) {
+    (void) iter;
+    (void) context;
+    PERF_COUNT(outbox_failed);
+    if (outbox_contents == OUTBOX_LOG) {
+        event_log_sending = 0;              // keep the records for the next flush
+    }
+    outbox_contents = OUTBOX_EMPTY;
+    LOG_WARNING(EVENT_OUTBOX_FAILED, reason, request_pending);
+    if ((request_pending != 0) && (request_timer == NULL) &&
+        (request_retries++ < MAX_REQUEST_RETRIES)) {
+        request_timer = app_timer_register(REQUEST_RETRY_MS, request_retry_callback, NULL);
+    }
+}
+
+/*
+ * Setters for each piece of zone data. Both the v1 per-key messages and the v2 delta updates
+ * go through these. They only store the new value and note what needs recomputing in
+ * wf->changes; commit_zone_changes() does that work once the whole message is decoded.
+ */
+void set_gmt_offset(uint32_t watch_num, int32_t gmt_sec_offset) {
+    if (gmt_sec_offset != watchfaces[watch_num].gmt_sec_offset) {
+        watchfaces[watch_num].gmt_sec_offset = gmt_sec_offset;
+        watchfaces[watch_num].sun_day = 0;      // sun times are in zone time
+        // Every zone's time is computed relative to watch 0's offset
+        for (int i = 0; i < MAX_WATCH_FACES; i++) {
+            if ((watch_num == 0) || (i == (int)watch_num)) {
+                watchfaces[i].changes |= ZONE_CHANGED_TIME | ZONE_CHANGED_BACKGROUND | ZONE_CHANGED_SUNS;
+            }
+        }
+    }
+}
+
+void set_city(uint32_t watch_num, const char *city, size_t len) {
+    WatchFace *wf = &watchfaces[watch_num];
+    if (len >= sizeof(wf->city)) {
+        len = sizeof(wf->city) - 1;
+    }
+    if ((strncmp(wf->city, city, len) != 0) || (wf->city[len] != '\0')) {
+        memcpy(wf->city, city, len);
+        wf->city[len] = '\0';
+        mark_zone_dirty(wf, VIEW_MAIN | VIEW_DETAIL);
+    }
+}
+
+void set_background(uint32_t watch_num, int background) {
+    if (background != watchfaces[watch_num].background) {
+        watchfaces[watch_num].background = background;
+        watchfaces[watch_num].changes |= ZONE_CHANGED_BACKGROUND | ZONE_CHANGED_SUNS;
+    }
+}
+
+void set_display(uint32_t watch_num, int display) {
+    if (display != watchfaces[watch_num].display) {
+        watchfaces[watch_num].display = display;
+        watchfaces[watch_num].time_style = time_style_for_display(display);
+        watchfaces[watch_num].changes |= ZONE_CHANGED_TIME;
+    }
+}
+
+void set_icons(uint32_t watch_num, const uint8_t *icons) {
+    WatchFace *wf = &watchfaces[watch_num];
+    for ( int j = 0; j < MAX_WEATHER_DAYS; j++ ) {
+        uint8_t icon = (icons[j] >= MAX_WEATHER_CONDITIONS) ? WEATHER_UNKNOWN : icons[j];
+        if (icon != wf->icon[j]) {
+            wf->icon[j] = icon;
+            mark_zone_dirty(wf, VIEW_DETAIL);
+        }
+    }
+}
+
+/*
+ * temps holds the current temperature followed by the highs and lows, as laid out from
+ * CURRENT_TEMP in PBCOMM_WEATHER_KEY data.
+ */
+void set_temps(uint32_t watch_num, const uint8_t *temps) {
+    WatchFace *wf = &watchfaces[watch_num];
+    bool temps_changed = false;
+
+    if ((int8_t)temps[0] != wf->temp) {
+        wf->temp = (int8_t)temps[0];
+        temps_changed = true;
+    }
+    for ( int j = 0; j < MAX_WEATHER_DAYS; j++ ) {
+        if ((int8_t)temps[j+MAX_TEMPS-CURRENT_TEMP] != wf->hi_temp[j]) {
+            wf->hi_temp[j] = (int8_t)temps[j+MAX_TEMPS-CURRENT_TEMP];
+            temps_changed = true;
+        }
+        if ((int8_t)temps[j+MIN_TEMPS-CURRENT_TEMP] != wf->lo_temp[j]) {
+            wf->lo_temp[j] = (int8_t)temps[j+MIN_TEMPS-CURRENT_TEMP];
+            temps_changed = true;
+        }
+    }
+    if (temps_changed) {
+        wf->changes |= ZONE_CHANGED_TEMPS;
+    }
+}
+
+/*
+ * suns holds sunrise hour/minute then sunset hour/minute, as laid out from SUNRISE_HOUR.
+ */
+void set_suns(uint32_t watch_num, const uint8_t *suns) {
+    WatchFace *wf = &watchfaces[watch_num];
+
+    if ((suns[SUNRISE_HOUR-SUNRISE_HOUR]   != wf->sunrise_hour) ||
+        (suns[SUNRISE_MINUTE-SUNRISE_HOUR] != wf->sunrise_min)  ||
+        (suns[SUNSET_HOUR-SUNRISE_HOUR]    != wf->sunset_hour)  ||
+        (suns[SUNSET_MINUTE-SUNRISE_HOUR]  != wf->sunset_min))     {
+        wf->sunrise_hour = suns[SUNRISE_HOUR-SUNRISE_HOUR];
+        wf->sunrise_min  = suns[SUNRISE_MINUTE-SUNRISE_HOUR];
+        wf->sunset_hour  = suns[SUNSET_HOUR-SUNRISE_HOUR];
+        wf->sunset_min   = suns[SUNSET_MINUTE-SUNRISE_HOUR];
+        wf->changes |= ZONE_CHANGED_BACKGROUND | ZONE_CHANGED_SUNS;
+    }
+}
+
+/*
+ * location holds latitude then longitude, as laid out in PBCOMM_LOCATION_KEY data. Once a
+ * zone has one its sun times are worked out here.
+ */
+void set_location(uint32_t watch_num, const uint8_t *location) {
+    WatchFace *wf = &watchfaces[watch_num];
+    int16_t latitude  = (int16_t)read_uint16(location + LOCATION_LATITUDE);
+    int16_t longitude = (int16_t)read_uint16(location + LOCATION_LONGITUDE);
+
+    if (!wf->has_location || (latitude != wf->latitude) || (longitude != wf->longitude)) {
+        wf->has_location = true;
+        wf->latitude = latitude;
+        wf->longitude = longitude;
+        wf->sun_day = 0;
+        wf->changes |= ZONE_CHANGED_BACKGROUND | ZONE_CHANGED_SUNS;
+    }
+}
+
+/*
+ * Replaces a watchface's table of upcoming GMT offset changes. Entries past MAX_TRANSITIONS
+ * are ignored, and data too short for one entry (the phone sends a 0 byte) empties the table.
+ */
+void set_transitions(uint32_t watch_num, const uint8_t *data, uint16_t length) {
+    WatchFace *wf = &watchfaces[watch_num];
+    uint8_t count = length / TRANSITION_LEN;
+
+    if (count > MAX_TRANSITIONS) {
+        count = MAX_TRANSITIONS;
+    }
+    memcpy(wf->transitions, data, count * TRANSITION_LEN);
+    wf->transition_count = count;
+}
+
+/*
+ * Switches each watchface to the GMT offset of every transition that's now due, without
+ * waiting for the phone. Returns true if any offset changed.
+ */
+bool apply_transitions() {
+    time_t now = time(NULL);        // UTC
+    bool changed = false;
+
+    for (int i = 0; i < MAX_WATCH_FACES; i++) {
+        WatchFace *wf = &watchfaces[i];
+        while (wf->transition_count > 0) {
+            if (transition_time(wf->transitions) > now) {
+                break;
+            }
+            set_gmt_offset(i, transition_offset(wf->transitions));
+            wf->transition_count--;
+            memmove(wf->transitions, &wf->transitions[TRANSITION_LEN],
+                    wf->transition_count * TRANSITION_LEN);
+            wf->unsaved = true;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+/*
+ * Applies a v2 PBCOMM_UPDATE_KEY message: a header followed by only the fields that changed.
+ * A sequence gap or a malformed message means we may have missed a delta, so whatever did
+ * arrive is applied and the phone is asked to resend everything.
+ */
+/*
+ * Notes that the phone has just sent a zone's current weather
+ */
+static void weather_arrived(uint32_t watch_num) {
+    watchfaces[watch_num].last_weather_update = time(NULL);
+    watchfaces[watch_num].days_rolled = 0;
+}
 
-    static char date_format[14] = "%a %b %e, %Y";
+void apply_update(uint32_t watch_num, const uint8_t *data, uint16_t length) {
+    WatchFace *wf = &watchfaces[watch_num];
+    bool      resync = false;
+    uint16_t  pos = UPDATE_HEADER_LEN;
 
-    time_t time_in_secs = time(NULL);
-    time_in_secs = (time_in_secs - local_gmt_offset) + wf->gmt_sec_offset;
-    struct tm *local_time = localtime(&time_in_secs);
+    if ((length < UPDATE_HEADER_LEN) || (data[UPDATE_VERSION] != UPDATE_PROTOCOL_V2)) {
+        LOG_ERROR(EVENT_BAD_UPDATE_HEADER, watch_num, length);
+        request_update_from_phone(REQUEST_FULL_UPDATE);
+        return;
+    }
 
-    strftime(wf->time_text, sizeof(wf->time_text), wf->time_format, local_time);
-    if ((!clock_is_24h_style()) &&
-        (wf->display != DISPLAY_24_HOUR_TIME) &&
-        (wf->time_text[0] == '0')) {
-        int pos = strlen(wf->time_text);
-        for (int k = 0; k < pos; k++) {
-            wf->time_text[k] = wf->time_text[k+1];
+    uint8_t fields = data[UPDATE_FIELDS];
+    uint8_t sequence = data[UPDATE_SEQUENCE];
+    if (!(fields & UPDATE_FULL)) {
+        if (sequence == wf->sequence) {
+            return;                         // already applied, a resend
         }
-    } 
-    layer_mark_dirty((Layer *)wf->main_time_layer);
-    layer_mark_dirty((Layer *)wf->text_time_layer);
+        resync = (sequence != (uint8_t)(wf->sequence + 1));
+    }
+    wf->sequence = sequence;
 
-    // Update date only if needed
-    if ((wf->last_day   != local_time->tm_mday)  ||
-        (wf->last_month != local_time->tm_mon)   ||
-        (wf->last_year  != local_time->tm_year))    {
-        strftime (wf->date_text, sizeof(wf->date_text), date_format, local_time);
-        wf->last_day   = local_time->tm_mday;
-        wf->last_month = local_time->tm_mon;
-        wf->last_year  = local_time->tm_year;
-        layer_mark_dirty((Layer *)wf->text_date_layer);
+    if (fields & UPDATE_HAS_OFFSET) {
+        if (pos + 4 > length) goto malformed;
+        set_gmt_offset(watch_num, (int32_t)((uint32_t)data[pos]           |
+                                            ((uint32_t)data[pos+1] << 8)  |
+                                            ((uint32_t)data[pos+2] << 16) |
+                                            ((uint32_t)data[pos+3] << 24)));
+        pos += 4;
+    }
+    if (fields & UPDATE_HAS_BACKGROUND) {
+        if (pos + 1 > length) goto malformed;
+        set_background(watch_num, data[pos++]);
+    }
+    if (fields & UPDATE_HAS_DISPLAY) {
+        if (pos + 1 > length) goto malformed;
+        set_display(watch_num, data[pos++]);
+    }
+    if (fields & UPDATE_HAS_ICONS) {
+        if (pos + UPDATE_ICONS_LEN > length) goto malformed;
+        set_icons(watch_num, &data[pos]);
+        pos += UPDATE_ICONS_LEN;
+    }
+    if (fields & UPDATE_HAS_TEMPS) {
+        if (pos + UPDATE_TEMPS_LEN > length) goto malformed;
+        set_temps(watch_num, &data[pos]);
+        pos += UPDATE_TEMPS_LEN;
+    }
+    if (fields & UPDATE_HAS_SUNS) {
+        if (pos + UPDATE_SUNS_LEN > length) goto malformed;
+        set_suns(watch_num, &data[pos]);
+        pos += UPDATE_SUNS_LEN;
+    }
+    if (fields & UPDATE_HAS_CITY) {
+        if ((pos + 1 > length) || (pos + 1 + data[pos] > length)) goto malformed;
+        set_city(watch_num, (const char *)&data[pos+1], data[pos]);
+        pos += 1 + data[pos];
     }
-    if (is_sunrise(local_time, wf) || is_sunset(local_time, wf)) {
-        update_background(wf, local_gmt_offset);
+    // Every v2 update answers a fresh forecast, so it dates the weather even when the weather
+    // matched the last one and the delta left it out
+    weather_arrived(watch_num);
+    if (resync) {
+        request_update_from_phone(REQUEST_FULL_UPDATE);
     }
+    return;
+
+malformed:
+    LOG_ERROR(EVENT_TRUNCATED_UPDATE, watch_num, length | ((int32_t)fields << 16));
+    request_update_from_phone(REQUEST_FULL_UPDATE);
 }
 
-void update_watches() {
-    for (int i=0; i<MAX_WATCH_FACES; i++) {
-        update_time(&watchfaces[i], watchfaces[0].gmt_sec_offset);
+/*
+ * Integer tuples arrive as 1, 2 or 4 byte values depending on the sender
+ */
+int32_t tuple_int(const Tuple *tuple) {
+    bool is_signed = (tuple->type == TUPLE_INT);
+    switch (tuple->length) {
+        case 1:
+            return is_signed ? tuple->value->int8 : tuple->value->uint8;
+        case 2:
+            return is_signed ? tuple->value->int16 : tuple->value->uint16;
+        default:
+            return tuple->value->int32;
     }
 }
 
-void handle_minute_tick(struct tm *t, TimeUnits units_changed) {
-    static int minutes_since_last_update = 0;
-    update_watches();
-    
-    // Every 30 minutes (MINUTES_BETWEEN_WEATHER_UPDATES) ask for a weather refresh
-    if (minutes_since_last_update >= MINUTES_BETWEEN_WEATHER_UPDATES ) {
-        request_update_from_phone();
-        minutes_since_last_update = 0;
-    } else {
-        minutes_since_last_update++;
-    }
+/*
+ * Turns the background worker on or off, as just saved in the configuration. Turning it on
+ * is the user choosing it, so it starts on exit even if another app's worker is running.
+ */
+void set_worker(bool enabled) {
+    persist_write_int(PERSIST_WORKER_KEY, enabled);
+    launch_worker = enabled;
 }
 
-// TODO: Error handling
-static void sync_error_callback(DictionaryResult dict_error, AppMessageResult app_message_error, void *context) {
-    (void) dict_error;
-    (void) app_message_error;
-    (void) context;
-    APP_LOG(APP_LOG_LEVEL_DEBUG, "sync_error_callback, %d", app_message_error); 
+/*
+ * Changes how many zones are shown. Zones that come into view are brought up to date, and a
+ * detail window showing a zone that went away returns to the main window.
+ */
+void set_zone_count(int count) {
+    if ((count < 1) || (count > MAX_WATCH_FACES) || (count == zone_count)) {
+        return;
+    }
+    for (int i = zone_count; i < count; i++) {
+        watchfaces[i].changes |= ZONE_CHANGED_TIME | ZONE_CHANGED_BACKGROUND | ZONE_CHANGED_SUNS;
+    }
+    zone_count = count;
+    persist_write_int(PERSIST_ZONE_COUNT_KEY, count);
+    if ((current_window > zone_count) && (detail != NULL)) {
+        window_stack_remove(detail->window, false);
+    }
+    if ((main_page * ROWS_PER_PAGE) >= zone_count) {
+        main_page = 0;
+    }
+    mark_main_rows_dirty();
 }
 
-static void sync_tuple_changed_callback(const uint32_t key, const Tuple* new_tuple,
-                                        const Tuple* old_tuple, void* context) {
-                                        
-    bool temps_changed = false;
-    bool suns_changed = false;
-    uint32_t watch_num = key / KEYS_PER_WATCH;
-    uint32_t function = key % KEYS_PER_WATCH;
-    
-    watchfaces[watch_num].last_weather_update = time(NULL);
+/*
+ * Decodes one tuple straight into its WatchFace
+ */
+void apply_tuple(const Tuple *tuple) {
+    uint32_t watch_num = tuple->key / KEYS_PER_WATCH;
+    uint32_t function = tuple->key % KEYS_PER_WATCH;
+
+    if (tuple->key == PBCOMM_ZONE_COUNT_KEY) {
+        set_zone_count(tuple_int(tuple));
+        return;
+    }
+    if (tuple->key == PBCOMM_TIMING_KEY) {
+        apply_timing(tuple->value->data, tuple->length);
+        return;
+    }
+    if (tuple->key == PBCOMM_WORKER_KEY) {
+        set_worker(tuple_int(tuple) != 0);
+        return;
+    }
+    if (watch_num >= MAX_WATCH_FACES) {
+        return;
+    }
+    watchfaces[watch_num].unsaved = true;
 
     switch (function) {
         case PBCOMM_GMT_SEC_OFFSET_KEY:
-            if (new_tuple->value->int32 != watchfaces[watch_num].gmt_sec_offset) {
-                watchfaces[watch_num].gmt_sec_offset = new_tuple->value->int32;
-                update_time(&watchfaces[watch_num], watchfaces[0].gmt_sec_offset);
-                update_background(&watchfaces[watch_num], watchfaces[0].gmt_sec_offset);
-            }
-            if (watch_num == 0) {
-                update_time(&watchfaces[1], watchfaces[0].gmt_sec_offset);
-                update_background(&watchfaces[1], watchfaces[0].gmt_sec_offset);
-                update_time(&watchfaces[2], watchfaces[0].gmt_sec_offset);
-                update_background(&watchfaces[2], watchfaces[0].gmt_sec_offset);
-            }
+            set_gmt_offset(watch_num, tuple_int(tuple));
             break;
         case PBCOMM_CITY_KEY:
-//          if (strcmp(new_tuple->value->cstring, old_tuple->value->cstring) != 0) {
-                text_layer_set_text(watchfaces[watch_num].text_city_layer, new_tuple->value->cstring);
-                text_layer_set_text(watchfaces[watch_num].main_city_layer, new_tuple->value->cstring);
-                layer_mark_dirty((Layer *)watchfaces[watch_num].text_city_layer);
-                layer_mark_dirty((Layer *)watchfaces[watch_num].main_city_layer);
-//          }
+            set_city(watch_num, tuple->value->cstring, strlen(tuple->value->cstring));
             break;
         case PBCOMM_BACKGROUND_KEY:
-            if (new_tuple->value->int8 != watchfaces[watch_num].background) {
-                watchfaces[watch_num].background = new_tuple->value->int8;
-                update_background(&watchfaces[watch_num], watchfaces[0].gmt_sec_offset);
-            }
+            set_background(watch_num, tuple_int(tuple));
             break;
         case PBCOMM_12_24_DISPLAY_KEY:
-            if (new_tuple->value->int8 != watchfaces[watch_num].display) {
-                watchfaces[watch_num].display = new_tuple->value->int8;
-                switch (watchfaces[watch_num].display) {
-                case DISPLAY_WATCH_CONFIG_TIME:
-                    if (clock_is_24h_style()) {
-                        strncpy (watchfaces[watch_num].time_format, time_24h_format, sizeof(time_24h_format));
-                    } else {
-                        strncpy (watchfaces[watch_num].time_format, time_12h_format, sizeof(time_12h_format));
-                    }
-                    break;	  
-                case DISPLAY_12_HOUR_TIME:
-                    strncpy (watchfaces[watch_num].time_format, time_12h_format, sizeof(time_12h_format));
-                    break;	  
-                case DISPLAY_24_HOUR_TIME:
-                default:
-                    strncpy (watchfaces[watch_num].time_format, time_24h_format, sizeof(time_24h_format));
-                    break;
-                }	  
-                update_time(&watchfaces[watch_num], watchfaces[0].gmt_sec_offset);
-            }
+            set_display(watch_num, tuple_int(tuple));
             break;
         case PBCOMM_WEATHER_KEY:
             // Includes all weather information in a byte array
-            for ( int j = 0; j < MAX_WEATHER_DAYS; j++ ) {
-//              if (new_tuple->value->data[j+WEATHER_ICONS] != old_tuple->value->data[j+WEATHER_ICONS] ) {
-                    if ((int8_t)new_tuple->value->data[j+WEATHER_ICONS] >= MAX_WEATHER_CONDITIONS) {
-                        bitmap_layer_set_bitmap(watchfaces[watch_num].bitmap_weather_layer[j+WEATHER_ICONS],
-                                                conditions[0]);
-                    } else {
-                        bitmap_layer_set_bitmap(watchfaces[watch_num].bitmap_weather_layer[j],
-                                                conditions[(int8_t)new_tuple->value->data[j+WEATHER_ICONS]]);
-                    }
-                    layer_mark_dirty((Layer *)watchfaces[watch_num].bitmap_weather_layer[j]);
-                    // temps_changed = true; not needed since the mark_dirty does what's needed
-//              }
-            }
-            if ((int8_t)new_tuple->value->data[CURRENT_TEMP] != watchfaces[watch_num].temp) {
-                watchfaces[watch_num].temp = (int8_t)new_tuple->value->data[CURRENT_TEMP];
-                temps_changed = true;
-            }
-            for ( int j = 0; j < MAX_WEATHER_DAYS; j++ ) {
-                if ((int8_t)new_tuple->value->data[j+MAX_TEMPS] != watchfaces[watch_num].hi_temp[j]) {
-                    watchfaces[watch_num].hi_temp[j] = (int8_t)new_tuple->value->data[j+MAX_TEMPS];
-                    temps_changed = true;
-                }
-            }
-            for ( int j = 0; j < MAX_WEATHER_DAYS; j++ ) {
-                if ((int8_t)new_tuple->value->data[j+MIN_TEMPS] != watchfaces[watch_num].lo_temp[j]) {
-                    watchfaces[watch_num].lo_temp[j] = (int8_t)new_tuple->value->data[j+MIN_TEMPS];
-                    temps_changed = true;
-                }
-            }
-            if (temps_changed) {
-                update_temps(&watchfaces[watch_num]);
+            if (tuple->length >= WEATHER_KEY_LEN) {
+                set_icons(watch_num, &tuple->value->data[WEATHER_ICONS]);
+                set_temps(watch_num, &tuple->value->data[CURRENT_TEMP]);
+                set_suns(watch_num, &tuple->value->data[SUNRISE_HOUR]);
+                weather_arrived(watch_num);
             }
-            if ((int8_t)new_tuple->value->data[SUNRISE_HOUR] != watchfaces[watch_num].sunrise_hour) {
-                watchfaces[watch_num].sunrise_hour = (int8_t)new_tuple->value->data[SUNRISE_HOUR];
-                suns_changed = true;
-            }
-            if ((int8_t)new_tuple->value->data[SUNRISE_MINUTE] != watchfaces[watch_num].sunrise_min) {
-                watchfaces[watch_num].sunrise_min = (int8_t)new_tuple->value->data[SUNRISE_MINUTE];
-                suns_changed = true;
-            }
-            if ((int8_t)new_tuple->value->data[SUNSET_HOUR] != watchfaces[watch_num].sunset_hour) {
-                watchfaces[watch_num].sunset_hour = (int8_t)new_tuple->value->data[SUNSET_HOUR];
-                suns_changed = true;
-            }
-            if ((int8_t)new_tuple->value->data[SUNSET_MINUTE] != watchfaces[watch_num].sunset_min) {
-                watchfaces[watch_num].sunset_min = (int8_t)new_tuple->value->data[SUNSET_MINUTE];
-                suns_changed = true;
-            }
-            if (suns_changed) {
-                update_background(&watchfaces[watch_num], watchfaces[0].gmt_sec_offset);
+            break;
+        case PBCOMM_UPDATE_KEY:
+            apply_update(watch_num, tuple->value->data, tuple->length);
+            break;
+        case PBCOMM_TRANSITIONS_KEY:
+            set_transitions(watch_num, tuple->value->data, tuple->length);
+            break;
+        case PBCOMM_LOCATION_KEY:
+            if (tuple->length >= LOCATION_LEN) {
+                set_location(watch_num, tuple->value->data);
             }
             break;
         default:
@@ -408,30 +1689,316 @@ static void sync_tuple_changed_callback(const uint32_t key, const Tuple* new_tup
 }
 
 /*
- * up_single_click_handler loads the next watchface, wrapping to the main window
+ * Recomputes and redraws each watchface a message changed, once, however many of its keys
+ * the message carried. A batched refresh of every zone is therefore a single render pass, and
+ * faces that aren't on screen are only marked stale until they appear.
+ */
+void commit_zone_changes() {
+    bool suns_changed = false;
+
+    for (int i = 0; i < MAX_WATCH_FACES; i++) {
+        WatchFace *wf = &watchfaces[i];
+        uint8_t changes = wf->changes;
+        wf->changes = 0;
+        if (!zone_on_screen(wf) &&
+            (changes & (ZONE_CHANGED_TIME | ZONE_CHANGED_BACKGROUND))) {
+            wf->stale = true;
+            changes &= ~(ZONE_CHANGED_TIME | ZONE_CHANGED_BACKGROUND);
+        }
+        if (changes & ZONE_CHANGED_TIME) {
+            update_time(wf, watchfaces[0].gmt_sec_offset);
+        }
+        if (changes & ZONE_CHANGED_BACKGROUND) {
+            update_background(wf, watchfaces[0].gmt_sec_offset);
+        }
+        if (changes & ZONE_CHANGED_TEMPS) {
+            update_temps(wf);
+        }
+        if (changes & ZONE_CHANGED_SUNS) {
+            suns_changed = true;
+        }
+    }
+    if (suns_changed) {
+        schedule_sun_changes();
+    }
+}
+
+/*
+ * Writes every changed watchface to persistent storage. Called from a debounce timer so a
+ * burst of messages costs one write per zone.
+ */
+void persist_zones(void *data) {
+    persist_timer = NULL;
+    for (int i = 0; i < MAX_WATCH_FACES; i++) {
+        WatchFace *wf = &watchfaces[i];
+        PersistedZone pz;
+        if (!wf->unsaved) {
+            continue;
+        }
+        pz.gmt_sec_offset = wf->gmt_sec_offset;
+        pz.last_weather_update = (uint32_t)wf->last_weather_update;
+        pz.background = wf->background;
+        pz.display = wf->display;
+        for (int j = 0; j < MAX_WEATHER_DAYS; j++) {
+            pz.weather[j+WEATHER_ICONS] = wf->icon[j];
+            pz.weather[j+MAX_TEMPS] = (uint8_t)wf->hi_temp[j];
+            pz.weather[j+MIN_TEMPS] = (uint8_t)wf->lo_temp[j];
+        }
+        pz.weather[CURRENT_TEMP] = (uint8_t)wf->temp;
+        pz.weather[SUNRISE_HOUR] = wf->sunrise_hour;
+        pz.weather[SUNRISE_MINUTE] = wf->sunrise_min;
+        pz.weather[SUNSET_HOUR] = wf->sunset_hour;
+        pz.weather[SUNSET_MINUTE] = wf->sunset_min;
+        memcpy(pz.city, wf->city, sizeof(pz.city));
+        pz.transition_count = wf->transition_count;
+        memcpy(pz.transitions, wf->transitions, sizeof(pz.transitions));
+        pz.days_rolled = wf->days_rolled;
+        pz.has_location = wf->has_location;
+        pz.location[LOCATION_LATITUDE]    = (uint16_t)wf->latitude & 0xFF;
+        pz.location[LOCATION_LATITUDE+1]  = (uint16_t)wf->latitude >> 8;
+        pz.location[LOCATION_LONGITUDE]   = (uint16_t)wf->longitude & 0xFF;
+        pz.location[LOCATION_LONGITUDE+1] = (uint16_t)wf->longitude >> 8;
+        persist_write_data(PERSIST_ZONE_KEY + i, &pz, sizeof(pz));
+        wf->unsaved = false;
+    }
+}
+
+void schedule_persist_zones() {
+    if ((persist_timer == NULL) || !app_timer_reschedule(persist_timer, PERSIST_DELAY_MS)) {
+        persist_timer = app_timer_register(PERSIST_DELAY_MS, persist_zones, NULL);
+    }
+}
+
+/*
+ * Deletes zone state stored in an older layout and records the current one. Run once at
+ * launch, before anything is restored, so persist_zones() never has to write the version.
+ */
+void check_persist_version() {
+    if (persist_read_int(PERSIST_VERSION_KEY) == PERSIST_VERSION) {
+        return;
+    }
+    for (int i = 0; i < MAX_WATCH_FACES; i++) {
+        persist_delete(PERSIST_ZONE_KEY + i);
+    }
+    persist_write_int(PERSIST_VERSION_KEY, PERSIST_VERSION);
+}
+
+/*
+ * Loads a watchface's last known state through the setters. Returns false, leaving the
+ * defaults in place, if nothing usable was stored.
+ */
+bool restore_zone(uint32_t watch_num) {
+    PersistedZone pz;
+
+    if (persist_read_data(PERSIST_ZONE_KEY + watch_num, &pz, sizeof(pz)) != sizeof(pz)) {
+        return false;
+    }
+    pz.city[sizeof(pz.city) - 1] = '\0';
+    set_gmt_offset(watch_num, pz.gmt_sec_offset);
+    set_background(watch_num, pz.background);
+    set_display(watch_num, pz.display);
+    set_city(watch_num, pz.city, strlen(pz.city));
+    set_icons(watch_num, &pz.weather[WEATHER_ICONS]);
+    set_temps(watch_num, &pz.weather[CURRENT_TEMP]);
+    set_suns(watch_num, &pz.weather[SUNRISE_HOUR]);
+    set_transitions(watch_num, pz.transitions, pz.transition_count * TRANSITION_LEN);
+    if (pz.has_location) {
+        set_location(watch_num, pz.location);
+    }
+    watchfaces[watch_num].last_weather_update = (time_t)pz.last_weather_update;
+    watchfaces[watch_num].days_rolled = pz.days_rolled;
+    return true;
+}
+
+void restore_zone_count() {
+    if (persist_exists(PERSIST_ZONE_COUNT_KEY)) {
+        int count = persist_read_int(PERSIST_ZONE_COUNT_KEY);
+        if ((count >= 1) && (count <= MAX_WATCH_FACES)) {
+            zone_count = count;
+        }
+    }
+}
+
+/*
+ * True if every watchface has data from the phone newer than the refresh interval
+ */
+bool zones_are_fresh() {
+    return (time(NULL) - oldest_zone_update()) < refresh_interval_secs();
+}
+
+/*
+ * Walks the incoming dictionary once, decoding every tuple into the WatchFace structs, then
+ * commits the changes.
+ */
+static void inbox_received_callback(DictionaryIterator *iter, void *context) {
+    PERF_BEGIN();
+    PERF_MESSAGE_IN(iter);
+    for (Tuple *tuple = dict_read_first(iter); tuple != NULL; tuple = dict_read_next(iter)) {
+        apply_tuple(tuple);
+    }
+    apply_transitions();
+    commit_zone_changes();
+    schedule_persist_zones();
+    PERF_END(PERF_INBOX_RECEIVED);
+}
+
+void watchface_click_config_provider(Window *window);
+void watchface_appear(Window *window);
+void watchface_disappear(Window *window);
+void watchface_unload(Window *window);
+
+/*
+ * Builds the detail window and its drawing layer. There's only ever one, bound to whichever
+ * zone is being shown, and it's only built when first pushed since most sessions never leave
+ * the main window. Returns false, with nothing left allocated, if the heap can't hold it.
+ */
+bool detail_view_create() {
+    DetailView *dv = malloc(sizeof(DetailView));
+
+    if (dv == NULL) {
+        LOG_ERROR(EVENT_NO_MEMORY, sizeof(DetailView), 0);
+        return false;
+    }
+    dv->zone = NULL;
+    dv->window = window_create();
+    dv->layer = (dv->window != NULL) ?
+                layer_create(layer_get_bounds(window_get_root_layer(dv->window))) : NULL;
+    if (dv->layer == NULL) {
+        LOG_ERROR(EVENT_NO_MEMORY, sizeof(DetailView), (dv->window != NULL) ? 2 : 1);
+        if (dv->window != NULL) {
+            window_destroy(dv->window);
+        }
+        free(dv);
+        return false;
+    }
+#ifdef PBL_PLATFORM_APLITE
+//    window_set_fullscreen(dv->window, true);
+#endif
+    window_set_click_config_provider(dv->window,
+                                     (ClickConfigProvider) watchface_click_config_provider);
+    window_set_window_handlers(dv->window, (WindowHandlers) {
+        .appear = watchface_appear,
+        .disappear = watchface_disappear,
+        .unload = watchface_unload
+    });
+
+    layer_set_update_proc(dv->layer, detail_update_proc);
+    layer_add_child(window_get_root_layer(dv->window), dv->layer);
+    detail = dv;
+    return true;
+}
+
+/*
+ * Binds the detail view to a watchface's data. Switching zones is a rebind rather
+ * than another window on the stack.
+ */
+void detail_view_bind(WatchFace *wf) {
+    DetailView *dv = detail;
+    bool shown = (dv->zone != NULL) && dv->zone->visible;
+
+    if (dv->zone == wf) {
+        return;
+    }
+    if (shown) {
+        dv->zone->visible = false;
+    }
+    dv->zone = wf;
+    update_temps(wf);
+    if (shown) {
+        wf->visible = true;
+        refresh_if_stale(wf);
+    }
+}
+
+void detail_view_destroy() {
+    DetailView *dv = detail;
+
+    if (dv == NULL) {
+        return;
+    }
+    layer_destroy(dv->layer);
+    window_destroy(dv->window);
+    free(dv);
+    detail = NULL;
+
+    // destroying a stacked window runs its unload handler, so cancel the idle timer last
+    if (detail_timer != NULL) {
+        app_timer_cancel(detail_timer);
+        detail_timer = NULL;
+    }
+}
+
+void detail_idle_callback(void *data) {
+    detail_timer = NULL;
+    if ((detail != NULL) && !window_stack_contains_window(detail->window)) {
+        detail_view_destroy();
+    }
+}
+
+/*
+ * Shows a watchface in the detail window, pushing the window only if it isn't already up.
+ * Returns false, leaving the main window up, if there's no memory for the detail window.
+ */
+bool show_detail(WatchFace *wf) {
+    PERF_BEGIN();
+    if (detail_timer != NULL) {
+        app_timer_cancel(detail_timer);
+        detail_timer = NULL;
+    }
+    if ((detail == NULL) && !detail_view_create()) {
+        return false;
+    }
+    detail_view_bind(wf);
+    if (!window_stack_contains_window(detail->window)) {
+        window_stack_push(detail->window, true);
+    }
+    PERF_END(PERF_SHOW_DETAIL);
+    return true;
+}
+
+/*
+ * up_single_click_handler shows the next watchface, returning to the main window after the last.
+ * From the main window it goes to the first watchface on the current page.
  */
 void up_single_click_handler(ClickRecognizerRef recognizer, void *context) {
-    switch (current_window) {
-        case 0:
-        case 1:
-        case 2:
-            window_stack_push(watchfaces[current_window].window, true);
-            current_window++;
-            break;
-        case 3:
-            for (int i = 0; i<MAX_WATCH_FACES; i++) {
-                window_stack_pop(true);
-            }
-            current_window = 0;
-            break;
-        default:
-            APP_LOG(APP_LOG_LEVEL_DEBUG, "up_single_click_handler: bad current_window: %d",
-                    current_window);
-            window_stack_pop_all(true);
-            window_stack_push(mainwindow, true);
-            current_window = 0;
-            break;
+    if (current_window == 0) {
+        int first = (main_page * ROWS_PER_PAGE) + 1;
+        if (show_detail(&watchfaces[first-1])) {
+            current_window = first;
+        }
+    } else if ((current_window > 0) && (current_window < zone_count)) {
+        show_detail(&watchfaces[current_window]);
+        current_window++;
+    } else if (current_window == zone_count) {
+        window_stack_pop(true);
+        current_window = 0;
+    } else {
+        LOG_ERROR(EVENT_BAD_CURRENT_WINDOW, current_window, 0);
+        window_stack_pop_all(true);
+        window_stack_push(mainwindow, true);
+        current_window = 0;
+    }
+}
+
+/*
+ * Shows another page of zones on the main window, catching up any that went stale while off it
+ */
+void set_main_page(int page) {
+    main_page = page;
+    for (int i = 0; i < zone_count; i++) {
+        if (zone_on_page(&watchfaces[i])) {
+            refresh_if_stale(&watchfaces[i]);
+        }
     }
+    mark_main_rows_dirty();
+}
+
+/*
+ * On the main window only, this pages through the zones
+ */
+void down_long_click_handler(ClickRecognizerRef recognizer, void *context) {
+    int pages = (zone_count + ROWS_PER_PAGE - 1) / ROWS_PER_PAGE;
+    set_main_page((main_page + 1) % pages);
 }
 
 /*
@@ -445,32 +2012,31 @@ void up_long_click_handler(ClickRecognizerRef recognizer, void *context) {
  * On the main window only, this forces a refresh of data
  */
 void select_refresh_single_click_handler(ClickRecognizerRef recognizer, void *context) {
-    request_update_from_phone();
+    request_update_from_phone(REQUEST_UPDATE);
 }
 
 /*
- * On the main window only, this forces a dump of watchface[i] data
+ * On the main window only, this logs the watchface[i] data and sends the event log to the
+ * phone, which prints it
  */
 void select_dump_long_click_handler(ClickRecognizerRef recognizer, void *context) {
-    for (int i=0; i < MAX_WATCH_FACES; i++) {
-        APP_LOG(APP_LOG_LEVEL_DEBUG, "\n\nData for watch: %d\n", i);
-        APP_LOG(APP_LOG_LEVEL_DEBUG,
-            "gmt_sec_offset: %d\nbackground: %d\ndisplay: %d\ntemp: %d\n",
-            (int)watchfaces[i].gmt_sec_offset, watchfaces[i].background, watchfaces[i].display,
-            watchfaces[i].temp );
-        for (int j=0; j < MAX_WEATHER_DAYS; j++) {
-            APP_LOG(APP_LOG_LEVEL_DEBUG,
-                "hi_temp[%d]: %d, lo_temp[%d]: %d\n",
-                j, watchfaces[i].hi_temp[j], j, watchfaces[i].lo_temp[j] );
-        }
-        APP_LOG(APP_LOG_LEVEL_DEBUG,
-            "sunrise_hour: %d\nsunrise_min: %d\nsunset_hour: %d\nsunset_min: %d\n",
-            watchfaces[i].sunrise_hour, watchfaces[i].sunrise_min,
-            watchfaces[i].sunset_hour, watchfaces[i].sunset_min );
-        APP_LOG(APP_LOG_LEVEL_DEBUG,
-            "time_text: %s\ntime_format: %s\ndate_text: %s\n",
-            watchfaces[i].time_text, watchfaces[i].time_format, watchfaces[i].date_text);
+#if EVENT_LOG_LEVEL >= EVENT_LEVEL_DEBUG
+    LOG_DEBUG(EVENT_DUMP, zone_count, main_page);
+    for (int i=0; i < zone_count; i++) {
+        WatchFace *wf = &watchfaces[i];
+        LOG_DEBUG(EVENT_ZONE_OFFSET, i, wf->gmt_sec_offset);
+        LOG_DEBUG(EVENT_ZONE_STYLE, i, LOG_BYTES(wf->background, wf->display, wf->time_style, 0));
+        LOG_DEBUG(EVENT_ZONE_HIGHS, i, LOG_BYTES(wf->temp, wf->hi_temp[0], wf->hi_temp[1], wf->hi_temp[2]));
+        LOG_DEBUG(EVENT_ZONE_LOWS, i, LOG_BYTES(wf->lo_temp[0], wf->lo_temp[1], wf->lo_temp[2], 0));
+        LOG_DEBUG(EVENT_ZONE_SUNS, i, LOG_BYTES(wf->sunrise_hour, wf->sunrise_min,
+                                                wf->sunset_hour, wf->sunset_min));
     }
+    latency_dump();
+#endif
+    event_log_flush();
+#ifdef PERF_COUNTERS
+    perf_dump();
+#endif
 }
 
 void statuswindow_timeout(void *callback_data) {
@@ -526,11 +2092,16 @@ void statuswindow_load () {
     layer_add_child(window_get_root_layer(statuswindow), (Layer *)status.batterystatus);
     layer_mark_dirty((Layer *)status.batterystatus);
     
-    // Format last weather update time for each watchface
-    for (int i = 0; i < MAX_WATCH_FACES; i++ ) {
+    // Format last weather update time for each watchface on the main window's current page
+    for (int i = 0; i < ROWS_PER_PAGE; i++ ) {
+        int zone = (main_page * ROWS_PER_PAGE) + i;
         status.weatherupdate[i] = text_layer_create(GRect(0,(i*20)+72,144,20));
-        local_time = localtime(&watchfaces[i].last_weather_update);
-        strftime(status.last_text[i], sizeof(status.last_text[i]), lastfmt, local_time);
+        if (zone < zone_count) {
+            local_time = localtime(&watchfaces[zone].last_weather_update);
+            strftime(status.last_text[i], sizeof(status.last_text[i]), lastfmt, local_time);
+        } else {
+            status.last_text[i][0] = '\0';
+        }
         text_layer_set_text(status.weatherupdate[i], status.last_text[i]);
 #ifdef PBL_COLOR
     text_layer_set_text_color(status.weatherupdate[i], GColorBlueMoon);
@@ -545,7 +2116,20 @@ void statuswindow_load () {
         layer_mark_dirty((Layer *)status.weatherupdate[i]);
     }
     
-    // Format other stuff???
+#ifdef PERF_COUNTERS
+    status.perf = text_layer_create(GRect(0, 0, 144, 168));
+    text_layer_set_text(status.perf, status.perf_text);
+#ifdef PBL_COLOR
+    text_layer_set_text_color(status.perf, GColorBlueMoon);
+    text_layer_set_background_color(status.perf, GColorChromeYellow);
+#else
+    text_layer_set_text_color(status.perf, GColorWhite);
+    text_layer_set_background_color(status.perf, GColorBlack);
+#endif
+    text_layer_set_font(status.perf, fonts_get_system_font(FONT_KEY_GOTHIC_14));
+    layer_set_hidden((Layer *)status.perf, true);
+    layer_add_child(window_get_root_layer(statuswindow), (Layer *)status.perf);
+#endif
 
 }
 
@@ -563,11 +2147,42 @@ void statuswindow_unload () {
     text_layer_destroy(status.batterystatus);
     
     // Deallocate text layers for last weather update time
-    for (int i=0; i<MAX_WATCH_FACES; i++ ) {
+    for (int i=0; i<ROWS_PER_PAGE; i++ ) {
         text_layer_destroy(status.weatherupdate[i]);
     }
     
+#ifdef PERF_COUNTERS
+    text_layer_destroy(status.perf);
+#endif
+}
+
+#ifdef PERF_COUNTERS
+/*
+ * On the status window, this flips between the status and perf pages and restarts the timeout
+ */
+void status_perf_single_click_handler(ClickRecognizerRef recognizer, void *context) {
+    Layer *perf_layer = (Layer *)status.perf;
+    if (layer_get_hidden(perf_layer)) {
+        perf_format(status.perf_text, sizeof(status.perf_text));
+    }
+    layer_set_hidden(perf_layer, !layer_get_hidden(perf_layer));
+    if (statuswindow_timer != NULL) {
+        app_timer_reschedule(statuswindow_timer, (uint32_t)7500);
+    }
+}
+
+/*
+ * On the status window, this dumps the perf counters to the log
+ */
+void status_perf_long_click_handler(ClickRecognizerRef recognizer, void *context) {
+    perf_dump();
+}
+
+void statuswindow_click_config_provider(Window *window) {
+    window_single_click_subscribe(BUTTON_ID_SELECT, status_perf_single_click_handler);
+    window_long_click_subscribe(BUTTON_ID_SELECT, 500, status_perf_long_click_handler, NULL);
 }
+#endif
 
 /*
  * When on a detail window, this will cycle between displaying:
@@ -580,34 +2195,67 @@ void statuswindow_unload () {
  */
 void select_temp_single_click_handler(ClickRecognizerRef recognizer, void *context) {
     temp_display = temp_display < 2 ? temp_display + 1 : 0;
-    update_temps(&watchfaces[current_window-1]);
+    update_temps(detail->zone);
 }
 
 /*
- * down_single_click_handler removes the current watchface, to the main window, and then
- * rotates to the last watchface
+ * down_single_click_handler shows the previous watchface, returning to the main window after
+ * the first. From the main window it goes straight to the last watchface on the current page.
  */
 void down_single_click_handler(ClickRecognizerRef recognizer, void *context) {
-    switch (current_window) {
-        case 0:
-            for (int i = 0; i < MAX_WATCH_FACES; i ++) {
-                window_stack_push(watchfaces[i].window, true);
-            }
-            current_window=3;
-            break;
-        case 1:
-        case 2:
-        case 3:
-            window_stack_pop(true);
-            current_window--;
-            break;
-        default:
-            APP_LOG(APP_LOG_LEVEL_DEBUG, "up_single_click_handler: bad current_window: %d",
-                    current_window);
-            window_stack_pop_all(true);
-            window_stack_push(mainwindow, true);
-            current_window = 0;
-            break;
+    if (current_window == 0) {
+        int last = (main_page + 1) * ROWS_PER_PAGE;
+        if (last > zone_count) {
+            last = zone_count;
+        }
+        if (show_detail(&watchfaces[last-1])) {
+            current_window = last;
+        }
+    } else if (current_window == 1) {
+        window_stack_pop(true);
+        current_window = 0;
+    } else if ((current_window > 1) && (current_window <= zone_count)) {
+        current_window--;
+        show_detail(&watchfaces[current_window-1]);
+    } else {
+        LOG_ERROR(EVENT_BAD_CURRENT_WINDOW, current_window, 1);
+        window_stack_pop_all(true);
+        window_stack_push(mainwindow, true);
+        current_window = 0;
+    }
+}
+
+void mainwindow_appear(Window *window) {
+    mainwindow_visible = true;
+    current_window = 0;         // also covers leaving the detail window with BACK
+    memset(main_row_redraw, ROW_REDRAW_ALL, sizeof(main_row_redraw));  // the window is redrawn anyway
+    for (int i=0; i<zone_count; i++) {
+        if (zone_on_page(&watchfaces[i])) {
+            refresh_if_stale(&watchfaces[i]);
+        }
+    }
+}
+
+void mainwindow_disappear(Window *window) {
+    mainwindow_visible = false;
+}
+
+void watchface_appear(Window *window) {
+    WatchFace *wf = detail->zone;
+    wf->visible = true;
+    refresh_if_stale(wf);
+}
+
+void watchface_disappear(Window *window) {
+    detail->zone->visible = false;
+}
+
+/*
+ * Popped off the stack. Keep the view around for a while in case it's pushed again soon.
+ */
+void watchface_unload(Window *window) {
+    if (detail_timer == NULL) {
+        detail_timer = app_timer_register(DETAIL_IDLE_MS, detail_idle_callback, NULL);
     }
 }
 
@@ -617,6 +2265,7 @@ void mainwindow_click_config_provider(Window *window) {
     window_single_click_subscribe(BUTTON_ID_SELECT,    select_refresh_single_click_handler);
     window_long_click_subscribe(BUTTON_ID_SELECT, 500, select_dump_long_click_handler, NULL);
     window_single_click_subscribe(BUTTON_ID_DOWN,      down_single_click_handler);
+    window_long_click_subscribe(BUTTON_ID_DOWN, 500,   down_long_click_handler, NULL);
 }
 
 void watchface_click_config_provider(Window *window) {
@@ -627,126 +2276,67 @@ void watchface_click_config_provider(Window *window) {
 
 void init() {
 
+#ifdef PERF_COUNTERS
+    perf_totals.started = time(NULL);
+#endif
+
+    // The app owns persistent storage while it's open; the worker takes over when it closes.
+    // Only one app's worker runs at a time, so ours is only started again if it's still the
+    // one the user chose: turned on, and running until now rather than replaced by another.
+    launch_worker = persist_exists(PERSIST_WORKER_KEY) && persist_read_int(PERSIST_WORKER_KEY) &&
+                    app_worker_is_running();
+    app_worker_kill();
+
     big_bold_font = fonts_get_system_font(FONT_KEY_BITHAM_30_BLACK);
     med_bold_font = fonts_get_system_font(FONT_KEY_GOTHIC_24_BOLD);
     small_bold_font = fonts_get_system_font(FONT_KEY_GOTHIC_18_BOLD);
   
-    conditions[WEATHER_UNKNOWN] = gbitmap_create_with_resource(RESOURCE_ID_WEATHER_UNKNOWN);
-    conditions[WEATHER_CLEAR_DAY] = gbitmap_create_with_resource(RESOURCE_ID_WEATHER_CLEAR_DAY);
-    conditions[WEATHER_CLEAR_NIGHT] = gbitmap_create_with_resource(RESOURCE_ID_WEATHER_CLEAR_NIGHT);
-    conditions[WEATHER_RAIN] = gbitmap_create_with_resource(RESOURCE_ID_WEATHER_RAIN);
-    conditions[WEATHER_SNOW] = gbitmap_create_with_resource(RESOURCE_ID_WEATHER_SNOW);
-//    conditions[WEATHER_SLEET] = gbitmap_create_with_resource(RESOURCE_ID_WEATHER_SLEET);
-    conditions[WEATHER_WIND] = gbitmap_create_with_resource(RESOURCE_ID_WEATHER_WIND);
-    conditions[WEATHER_FOG] = gbitmap_create_with_resource(RESOURCE_ID_WEATHER_FOG);
-    conditions[WEATHER_CLOUDY] = gbitmap_create_with_resource(RESOURCE_ID_WEATHER_CLOUDY);
-    conditions[WEATHER_PARTLY_CLOUDY_DAY] = gbitmap_create_with_resource(RESOURCE_ID_WEATHER_PARTLY_CLOUDY_DAY);
-    conditions[WEATHER_PARTLY_CLOUDY_NIGHT] = gbitmap_create_with_resource(RESOURCE_ID_WEATHER_PARTLY_CLOUDY_NIGHT);
+    // All of the weather icons live in one resource, sliced into sub-bitmaps that share its data
+    weather_atlas = gbitmap_create_with_resource(RESOURCE_ID_WEATHER_ATLAS);
+    for (int i = 0; i < MAX_WEATHER_CONDITIONS; i++) {
+        conditions[i] = gbitmap_create_as_sub_bitmap(weather_atlas,
+                                                     GRect(0, weather_atlas_cell[i]*WEATHER_ICON_SIZE,
+                                                           WEATHER_ICON_SIZE, WEATHER_ICON_SIZE));
+    }
   
     // Set up main window
     mainwindow = window_create();
-    window_set_background_color(mainwindow, GColorBlack);
+    window_set_background_color(mainwindow, GColorClear);   // the rows cover it
 #ifdef PBL_PLATFORM_APLITE
 //  window_set_fullscreen(mainwindow, true);
 #endif
+    window_set_window_handlers(mainwindow, (WindowHandlers) {
+        .appear = mainwindow_appear,
+        .disappear = mainwindow_disappear
+    });
   
-    for ( int i = 0; i < MAX_WATCH_FACES; i++) {
-  
-        // This layer displays the time. 12-hour, 24-hour or how the watch is configured
-        watchfaces[i].main_time_layer = text_layer_create(GRect(0, i*56, 144, 32));
-        text_layer_set_text(watchfaces[i].main_time_layer, watchfaces[i].time_text);
-        text_layer_set_text_color(watchfaces[i].main_time_layer, GColorWhite);
-        text_layer_set_background_color(watchfaces[i].main_time_layer, GColorClear);
-        text_layer_set_font(watchfaces[i].main_time_layer, big_bold_font);
-        text_layer_set_text_alignment(watchfaces[i].main_time_layer, GTextAlignmentCenter);
-        layer_add_child(window_get_root_layer(mainwindow), (Layer *)watchfaces[i].main_time_layer);
-
-        // This layer displays the selected time zone city, including GMT offset
-        watchfaces[i].main_city_layer = text_layer_create(GRect(0, (i*56)+32, 144, 24));
-        text_layer_set_text_color(watchfaces[i].main_city_layer, GColorWhite);
-        text_layer_set_background_color(watchfaces[i].main_city_layer, GColorClear);
-        text_layer_set_font(watchfaces[i].main_city_layer, small_bold_font);
-        text_layer_set_text_alignment(watchfaces[i].main_city_layer, GTextAlignmentCenter);
-        layer_add_child(window_get_root_layer(mainwindow), (Layer *)watchfaces[i].main_city_layer);
-    
-        watchfaces[i].window = window_create();  
-        window_set_background_color(watchfaces[i].window, GColorBlack);
-#ifdef PBL_PLATFORM_APLITE
-//        window_set_fullscreen(watchfaces[i].window, true);
-#endif
-        window_set_click_config_provider(watchfaces[i].window,
-                                         (ClickConfigProvider) watchface_click_config_provider);
-
-        // This layer displays the time. 12-hour, 24-hour or how the watch is configured
-        watchfaces[i].text_time_layer = text_layer_create(GRect(0, 6, 144, 44));
-        text_layer_set_text(watchfaces[i].text_time_layer, watchfaces[i].time_text);
-        text_layer_set_text_color(watchfaces[i].text_time_layer, GColorWhite);
-        text_layer_set_background_color(watchfaces[i].text_time_layer, GColorClear);
-        text_layer_set_font(watchfaces[i].text_time_layer, big_bold_font);
-        text_layer_set_text_alignment(watchfaces[i].text_time_layer, GTextAlignmentCenter);
-        layer_add_child(window_get_root_layer(watchfaces[i].window), (Layer *)watchfaces[i].text_time_layer);
-    
-        // This layer displays the date
-        watchfaces[i].text_date_layer = text_layer_create(GRect(0, 44, 144, 28));
-        text_layer_set_text(watchfaces[i].text_date_layer, watchfaces[i].date_text);
-        text_layer_set_text_color(watchfaces[i].text_date_layer, GColorWhite);
-        text_layer_set_background_color(watchfaces[i].text_date_layer, GColorClear);
-        text_layer_set_font(watchfaces[i].text_date_layer, med_bold_font);
-        text_layer_set_text_alignment(watchfaces[i].text_date_layer, GTextAlignmentCenter);
-        layer_add_child(window_get_root_layer(watchfaces[i].window), (Layer *)watchfaces[i].text_date_layer);
-    
-        // This layer displays the selected time zone city, including GMT offset
-        watchfaces[i].text_city_layer = text_layer_create(GRect(0, 72, 146, 22));
-        text_layer_set_text_color(watchfaces[i].text_city_layer, GColorWhite);
-        text_layer_set_background_color(watchfaces[i].text_city_layer, GColorClear);
-        text_layer_set_font(watchfaces[i].text_city_layer, small_bold_font);
-        text_layer_set_text_alignment(watchfaces[i].text_city_layer, GTextAlignmentCenter);
-        layer_add_child(window_get_root_layer(watchfaces[i].window), (Layer *)watchfaces[i].text_city_layer);
-    
-        for ( int j = 0; j < MAX_WEATHER_DAYS; j++ ) {
-            // This layer displays a weather image, if available.
-            watchfaces[i].bitmap_weather_layer[j] = bitmap_layer_create(GRect(9+(j*(36+9)), 94, 36, 36));
-            bitmap_layer_set_background_color(watchfaces[i].bitmap_weather_layer[j], GColorClear);
-            bitmap_layer_set_alignment(watchfaces[i].bitmap_weather_layer[j], GAlignCenter);
-            bitmap_layer_set_compositing_mode(watchfaces[i].bitmap_weather_layer[j], GCompOpAssignInverted);
-            bitmap_layer_set_bitmap(watchfaces[i].bitmap_weather_layer[j], conditions[WEATHER_UNKNOWN]);
-            layer_add_child(window_get_root_layer(watchfaces[i].window), (Layer *)watchfaces[i].bitmap_weather_layer[j]);
-
-            // This layer displays the time zone temperature, high and low, below the weather icon
-            watchfaces[i].text_temp_layer[j] = text_layer_create(GRect(9+(j*(36+9)), 130, 36, 38));
-            text_layer_set_text(watchfaces[i].text_temp_layer[j], watchfaces[i].temps[j]);
-            text_layer_set_text_color(watchfaces[i].text_temp_layer[j], GColorWhite);
-            text_layer_set_background_color(watchfaces[i].text_temp_layer[j], GColorClear);
-            text_layer_set_font(watchfaces[i].text_temp_layer[j], small_bold_font);
-            text_layer_set_text_alignment(watchfaces[i].text_temp_layer[j], GTextAlignmentCenter);
-            layer_add_child(window_get_root_layer(watchfaces[i].window), (Layer *)watchfaces[i].text_temp_layer[j]);
-        }
-    }
-    Tuplet initial_values[] = {
-        TupletInteger(LOCAL_WATCH_OFFSET+PBCOMM_GMT_SEC_OFFSET_KEY, (int32_t) -28800),
-        TupletInteger(LOCAL_WATCH_OFFSET+PBCOMM_BACKGROUND_KEY,     (uint8_t) BACKGROUND_SUNS),
-        TupletInteger(LOCAL_WATCH_OFFSET+PBCOMM_12_24_DISPLAY_KEY,  (uint8_t) DISPLAY_WATCH_CONFIG_TIME),
-        TupletCString(LOCAL_WATCH_OFFSET+PBCOMM_CITY_KEY,                     "Watch Time"),
-        TupletBytes(  LOCAL_WATCH_OFFSET+PBCOMM_WEATHER_KEY,        weather,  WEATHER_KEY_LEN),
-          
-        TupletInteger(TZ1_WATCH_OFFSET+PBCOMM_GMT_SEC_OFFSET_KEY,   (int32_t) 0),
-        TupletInteger(TZ1_WATCH_OFFSET+PBCOMM_BACKGROUND_KEY,       (uint8_t) BACKGROUND_SUNS),
-        TupletInteger(TZ1_WATCH_OFFSET+PBCOMM_12_24_DISPLAY_KEY,    (uint8_t) DISPLAY_24_HOUR_TIME),
-        TupletCString(TZ1_WATCH_OFFSET+PBCOMM_CITY_KEY,                       "London, England"),
-        TupletBytes(  TZ1_WATCH_OFFSET+PBCOMM_WEATHER_KEY,          weather,  WEATHER_KEY_LEN),
-          
-        TupletInteger(TZ2_WATCH_OFFSET+PBCOMM_GMT_SEC_OFFSET_KEY,   (int32_t) 32400),
-        TupletInteger(TZ2_WATCH_OFFSET+PBCOMM_BACKGROUND_KEY,       (uint8_t) BACKGROUND_SUNS),
-        TupletInteger(TZ2_WATCH_OFFSET+PBCOMM_12_24_DISPLAY_KEY,    (uint8_t) DISPLAY_24_HOUR_TIME),
-        TupletCString(TZ2_WATCH_OFFSET+PBCOMM_CITY_KEY,                       "Tokyo, Japan"),
-        TupletBytes(  TZ2_WATCH_OFFSET+PBCOMM_WEATHER_KEY,          weather,  WEATHER_KEY_LEN)
-    };
+    // One layer per row on a page, shared by every page. Each shows a zone's time above its
+    // city, including GMT offset.
+    for (int r = 0; r < ROWS_PER_PAGE; r++) {
+        main_rows[r] = layer_create_with_data(GRect(0, r*ROW_HEIGHT, 144, ROW_HEIGHT), sizeof(int));
+        *(int *)layer_get_data(main_rows[r]) = r;
+        layer_set_update_proc(main_rows[r], main_row_update_proc);
+        layer_add_child(window_get_root_layer(mainwindow), main_rows[r]);
+    }
     
-    // Initialize watchfaces[].time_format as it may be used before sync_tuple_changed_callback
-    // is executed to set up the proper value.
+    // Show the last known state, or the defaults, until the phone sends real data
+    check_persist_version();
+    restore_zone_count();
     for (int i = 0; i < MAX_WATCH_FACES; i++) {
-        strncpy (watchfaces[i].time_format, time_12h_format, sizeof(time_12h_format));
+        const char *city = (zone_defaults[i].city != NULL) ? zone_defaults[i].city : "";
+        watchfaces[i].time_style = time_style_for_display(DISPLAY_WATCH_CONFIG_TIME);
+        set_gmt_offset(i, zone_defaults[i].gmt_sec_offset);
+        set_background(i, BACKGROUND_SUNS);
+        set_display(i, zone_defaults[i].display);
+        set_city(i, city, strlen(city));
+        set_icons(i, &weather[WEATHER_ICONS]);
+        set_temps(i, &weather[CURRENT_TEMP]);
+        set_suns(i, &weather[SUNRISE_HOUR]);
+        restore_zone(i);
+        watchfaces[i].changes |= ZONE_CHANGED_TIME | ZONE_CHANGED_BACKGROUND | ZONE_CHANGED_TEMPS;
     }
+    apply_transitions();            // any that passed while the app was closed
+    commit_zone_changes();
     
     // Initialize status window, but don't populate unless it's requested via tap
     statuswindow = window_create();
@@ -759,47 +2349,67 @@ void init() {
         .load = statuswindow_load,
         .unload = statuswindow_unload
     });
+#ifdef PERF_COUNTERS
+    window_set_click_config_provider(statuswindow,
+                                     (ClickConfigProvider)statuswindow_click_config_provider);
+#endif
     statuswindow_timer = NULL;
     /* decide how to get this window, long click is already used */
 
     
+    app_message_register_inbox_received(inbox_received_callback);
+    app_message_register_inbox_dropped(inbox_dropped_callback);
+    app_message_register_outbox_sent(outbox_sent_callback);
+    app_message_register_outbox_failed(outbox_failed_callback);
     app_message_open(app_message_inbox_size_maximum(), app_message_outbox_size_maximum());
-    app_sync_init(&sync, sync_buffer, sizeof(sync_buffer), initial_values, ARRAY_LENGTH(initial_values),
-                  sync_tuple_changed_callback, sync_error_callback, NULL);
     window_set_click_config_provider(mainwindow,
                                      (ClickConfigProvider) mainwindow_click_config_provider);
     window_stack_push(mainwindow, true /* Animated */);  
     tick_timer_service_subscribe(MINUTE_UNIT, handle_minute_tick);
-    request_update_from_phone();  
+    battery = battery_state_service_peek();
+    battery_state_service_subscribe(battery_handler);
+    phone_connected = connection_service_peek_pebble_app_connection();
+    connection_service_subscribe((ConnectionHandlers) {
+        .pebble_app_connection_handler = connection_handler
+    });
+    if (!zones_are_fresh()) {
+        request_update_from_phone(REQUEST_FULL_UPDATE);
+    }
 }
 
 void deinit() {
-    app_sync_deinit(&sync);
-    gbitmap_destroy(conditions[WEATHER_UNKNOWN]);
-    gbitmap_destroy(conditions[WEATHER_CLEAR_DAY]);
-    gbitmap_destroy(conditions[WEATHER_CLEAR_NIGHT]);
-    gbitmap_destroy(conditions[WEATHER_RAIN]);
-    gbitmap_destroy(conditions[WEATHER_SNOW]);
-//    gbitmap_destroy(conditions[WEATHER_SLEET]);
-    gbitmap_destroy(conditions[WEATHER_WIND]);
-    gbitmap_destroy(conditions[WEATHER_FOG]);
-    gbitmap_destroy(conditions[WEATHER_CLOUDY]);
-    gbitmap_destroy(conditions[WEATHER_PARTLY_CLOUDY_DAY]);
-    gbitmap_destroy(conditions[WEATHER_PARTLY_CLOUDY_NIGHT]);
+    app_message_deregister_callbacks();
+    battery_state_service_unsubscribe();
+    connection_service_unsubscribe();
+    if (sun_timer != NULL) {
+        app_timer_cancel(sun_timer);
+        sun_timer = NULL;
+    }
+    if (request_timer != NULL) {
+        app_timer_cancel(request_timer);
+        request_timer = NULL;
+    }
+    if (request_timing.timeout != NULL) {
+        app_timer_cancel(request_timing.timeout);
+        request_timing.timeout = NULL;
+    }
+    if (persist_timer != NULL) {
+        app_timer_cancel(persist_timer);
+        persist_zones(NULL);
+    }
+    if (launch_worker) {
+        app_worker_launch();
+    }
+    for (int i = 0; i < MAX_WEATHER_CONDITIONS; i++) {
+        gbitmap_destroy(conditions[i]);
+    }
+    gbitmap_destroy(weather_atlas);
    
     // Destroy layers and window    
-    for ( int i = 0; i < MAX_WATCH_FACES; i++) {
-        text_layer_destroy(watchfaces[i].main_time_layer);
-        text_layer_destroy(watchfaces[i].main_city_layer);
-        text_layer_destroy(watchfaces[i].text_time_layer);
-        text_layer_destroy(watchfaces[i].text_city_layer);
-        text_layer_destroy(watchfaces[i].text_date_layer);
-        for (int j = 0; j < MAX_WEATHER_DAYS; j++ ) {
-            bitmap_layer_destroy(watchfaces[i].bitmap_weather_layer[j]);
-            text_layer_destroy(watchfaces[i].text_temp_layer[j]);
-        }
-        window_destroy(watchfaces[i].window);
+    for (int r = 0; r < ROWS_PER_PAGE; r++) {
+        layer_destroy(main_rows[r]);
     }
+    detail_view_destroy();
     window_destroy(statuswindow);
     window_destroy(mainwindow);
 }
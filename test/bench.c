@@ -0,0 +1,230 @@
+//
+//  bench.c
+//  Times the watch's hot paths on the host and counts what each call costs: redraws
+//  (layer_mark_dirty), heap allocations and calendar conversions. Given a baseline file it
+//  compares against it; the counts are exact, so any increase in one fails.
+//
+//  bench [baseline]
+//
+
+// The app's main() falls off the end, which is fine for main() but not once it's renamed
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wreturn-type"
+#define main worldtimej_main
+#include "../src/worldtimej.c"
+#undef main
+#pragma GCC diagnostic pop
+
+#include "stub.h"
+
+#define BENCH_START     1444176000      // 2015-10-07 00:00 UTC
+#define BENCH_OPS       20000
+#define BENCH_REPEATS   5               // the fastest run is reported, the counts are the same
+
+typedef struct {
+    const char  *name;
+    void       (*setup)(void);
+    void       (*op)(int i);
+    const char  *was;                   // the baseline row for the path this one replaced, if any
+} Bench;
+
+typedef struct {
+    double       ns;
+    double       dirty;
+    double       allocs;
+    double       heap;
+    double       localtime;
+} BenchResult;
+
+static struct tm tick_time(time_t now) {
+    struct tm t;
+    time_t local = now + watchfaces[0].gmt_sec_offset;
+    gmtime_r(&local, &t);
+    return t;
+}
+
+// Moves the clock to the ith minute the way a tick does, handing its time over as the
+// reference for the zones
+static void tick_clock(int i) {
+    time_t now = BENCH_START + (time_t)i * 60;
+    stub_set_time(now, 0);
+    clock_ref.tm = tick_time(now);
+    clock_ref.secs = now;
+}
+
+static void setup_main(void) {
+    while (window_stack_get_top_window() != mainwindow) {
+        window_stack_pop(false);
+    }
+    for (int i = 0; i < zone_count; i++) {
+        watchfaces[i].background = BACKGROUND_SUNS;
+    }
+}
+
+static void setup_detail(void) {
+    setup_main();
+    show_detail(&watchfaces[1]);
+}
+
+static void op_minute_tick(int i) {
+    time_t now = BENCH_START + (time_t)i * 60;
+    struct tm t = tick_time(now);
+    stub_set_time(now, 0);
+    handle_minute_tick(&t, MINUTE_UNIT);
+}
+
+static void op_update_time(int i) {
+    tick_clock(i);
+    update_time(&watchfaces[1], watchfaces[0].gmt_sec_offset);
+}
+
+static void op_update_background(int i) {
+    tick_clock(i);
+    update_background(&watchfaces[1], watchfaces[0].gmt_sec_offset);
+}
+
+// Every zone's time for one tick, as handle_minute_tick needs it, by the current path and by
+// the one it replaced: a full conversion per zone
+static void op_zone_times(int i) {
+    tick_clock(i);
+    for (int z = 0; z < MAX_WATCH_FACES; z++) {
+        zone_time(&watchfaces[z], watchfaces[0].gmt_sec_offset);
+    }
+}
+
+static struct tm full_tm[MAX_WATCH_FACES];
+
+static void op_zone_times_full(int i) {
+    tick_clock(i);
+    for (int z = 0; z < MAX_WATCH_FACES; z++) {
+        time_t secs = (time(NULL) - watchfaces[0].gmt_sec_offset) + watchfaces[z].gmt_sec_offset;
+        full_tm[z] = *localtime(&secs);
+    }
+}
+
+static void op_update_temps(int i) {
+    watchfaces[1].temp = (int8_t)(i % 40);
+    update_temps(&watchfaces[1]);
+}
+
+// One v2 update per sequence number, each changing zone 1's temperatures
+static uint8_t inbox_messages[256][64];
+static uint16_t inbox_sizes[256];
+
+static void setup_inbox(void) {
+    setup_main();
+    for (int s = 0; s < 256; s++) {
+        DictionaryIterator iter;
+        uint8_t update[UPDATE_HEADER_LEN + UPDATE_TEMPS_LEN] = {
+            UPDATE_PROTOCOL_V2, (uint8_t)s, UPDATE_HAS_TEMPS,
+            (uint8_t)(s % 40), 20, 21, 22, 10, 11, 12
+        };
+        dict_write_begin(&iter, inbox_messages[s], sizeof(inbox_messages[s]));
+        dict_write_data(&iter, TZ1_WATCH_OFFSET + PBCOMM_UPDATE_KEY, update, sizeof(update));
+        inbox_sizes[s] = dict_write_end(&iter);
+    }
+    watchfaces[1].sequence = 255;
+}
+
+static void op_inbox_received(int i) {
+    DictionaryIterator iter;
+    dict_read_begin_from_buffer(&iter, inbox_messages[i % 256], inbox_sizes[i % 256]);
+    inbox_received_callback(&iter, NULL);
+}
+
+static const Bench benches[] = {
+    { "handle_minute_tick",          setup_main,     op_minute_tick,         NULL },
+    { "update_time",                 setup_main,     op_update_time,         NULL },
+    { "update_background",           setup_main,     op_update_background,   NULL },
+    { "zone_time_all",               setup_main,     op_zone_times,          NULL },
+    { "zone_time_all_full",          setup_main,     op_zone_times_full,     NULL },
+    { "update_temps",                setup_detail,   op_update_temps,        NULL },
+    { "inbox_received_callback",     setup_inbox,    op_inbox_received,      "sync_tuple_changed_callback" },
+};
+
+#define NUM_BENCHES (sizeof(benches) / sizeof(benches[0]))
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static BenchResult run(const Bench *bench) {
+    BenchResult result;
+
+    bench->setup();
+    result.ns = 0;
+    for (int r = 0; r < BENCH_REPEATS; r++) {
+        stub_set_time(BENCH_START, 0);
+        stub_reset_counters();
+        size_t heap = heap_bytes_used();
+        double start = now_ns();
+        for (int i = 0; i < BENCH_OPS; i++) {
+            bench->op(i);
+        }
+        double ns = (now_ns() - start) / BENCH_OPS;
+        if ((r == 0) || (ns < result.ns)) {
+            result.ns = ns;
+        }
+        result.heap = ((double)heap_bytes_used() - heap) / BENCH_OPS;
+    }
+    result.dirty = (double)stub_counters.dirty_marks / BENCH_OPS;
+    result.allocs = (double)stub_counters.allocs / BENCH_OPS;
+    result.localtime = (double)stub_counters.localtime_calls / BENCH_OPS;
+    return result;
+}
+
+static bool read_baseline(FILE *file, const char *name, BenchResult *result) {
+    char line[160];
+    char found[64];
+
+    rewind(file);
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if ((sscanf(line, "%63s %lf %lf %lf %lf %lf", found, &result->ns, &result->dirty,
+                    &result->allocs, &result->heap, &result->localtime) == 6) &&
+            (strcmp(found, name) == 0)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char **argv) {
+    FILE *baseline = NULL;
+    int regressions = 0;
+
+    if (argc > 1) {
+        baseline = fopen(argv[1], "r");
+        if (baseline == NULL) {
+            perror(argv[1]);
+            return 2;
+        }
+    }
+
+    stub_set_time(BENCH_START, 0);
+    init();
+    stub_set_utc_offset(watchfaces[0].gmt_sec_offset);     // the watch's own zone, from its defaults
+
+    printf("%-28s %10s %9s %9s %9s %12s\n", "# path", "ns/op", "dirty/op", "allocs/op", "heap/op", "localtime/op");
+    for (size_t b = 0; b < NUM_BENCHES; b++) {
+        BenchResult result = run(&benches[b]);
+        BenchResult base;
+        printf("%-28s %10.1f %9.2f %9.2f %9.2f %12.4f", benches[b].name, result.ns, result.dirty,
+               result.allocs, result.heap, result.localtime);
+        if ((baseline != NULL) &&
+            read_baseline(baseline, benches[b].was ? benches[b].was : benches[b].name, &base)) {
+            bool worse = (result.dirty > base.dirty + 0.005) || (result.allocs > base.allocs + 0.005) ||
+                         (result.heap > base.heap + 0.005) || (result.localtime > base.localtime + 0.00005);
+            printf("   %+6.1f%% ns%s", (result.ns - base.ns) * 100 / base.ns, worse ? "  REGRESSED" : "");
+            regressions += worse;
+        }
+        printf("\n");
+    }
+
+    deinit();
+    if (baseline != NULL) {
+        fclose(baseline);
+    }
+    return regressions ? 1 : 0;
+}
@@ -0,0 +1,68 @@
+//
+//  heap_test.c
+//  Follows the heap through a session: the high-water mark at startup and with the detail
+//  window up, the detail view freed once it's been idle, and the detail window failing to
+//  build at each of its allocations without leaking or leaving the main window.
+//
+
+#include "test_util.h"
+
+#define DETAIL_ALLOCS   3               // the view, its window and its layer
+
+int main(void) {
+    size_t heap_size = heap_bytes_used() + heap_bytes_free();
+
+    launch(NULL);
+    size_t startup_used = heap_bytes_used();
+    size_t startup_peak = stub_heap_peak();
+    printf("heap at startup: %zu bytes used, %zu peak of %zu\n", startup_used, startup_peak, heap_size);
+    expect(detail == NULL, "no detail view until it's first shown");
+
+    // The first press of up builds the detail window
+    stub_reset_heap_peak();
+    stub_click(BUTTON_ID_UP);
+    stub_advance(1000);
+    printf("heap with the detail window up: %zu bytes used, %zu peak\n",
+           heap_bytes_used(), stub_heap_peak());
+    expect(window_stack_get_top_window() == detail->window, "detail window shown");
+    expect(stub_heap_peak() < heap_size, "detail window fits the heap");
+
+    // Popped, it's kept for a while in case it comes back, then freed
+    stub_click(BUTTON_ID_DOWN);
+    stub_advance(DETAIL_IDLE_MS / 2);
+    expect(detail != NULL, "detail view kept while recently used");
+    stub_advance(DETAIL_IDLE_MS);
+    expect(detail == NULL, "detail view freed once idle");
+    expect(heap_bytes_used() == startup_used, "heap back to its startup size once idle");
+
+    // Each allocation the detail window needs fails in turn: the press does nothing and
+    // whatever was allocated before the failure is given back
+    for (int nth = 1; nth <= DETAIL_ALLOCS; nth++) {
+        char what[80];
+        stub_fail_malloc(nth);
+        stub_click(BUTTON_ID_UP);
+        stub_advance(1000);
+        stub_fail_malloc(0);
+        snprintf(what, sizeof(what), "allocation %d failing leaves the main window up", nth);
+        expect((window_stack_get_top_window() == mainwindow) && (current_window == 0), what);
+        snprintf(what, sizeof(what), "allocation %d failing leaks nothing", nth);
+        expect((detail == NULL) && (heap_bytes_used() == startup_used), what);
+    }
+
+    // Down from the main window fails the same way
+    stub_fail_malloc(1);
+    stub_click(BUTTON_ID_DOWN);
+    stub_advance(1000);
+    stub_fail_malloc(0);
+    expect((window_stack_get_top_window() == mainwindow) && (current_window == 0),
+           "down failing leaves the main window up");
+
+    // Once memory is back the same press works
+    stub_click(BUTTON_ID_DOWN);
+    stub_advance(1000);
+    expect((detail != NULL) && (window_stack_get_top_window() == detail->window),
+           "detail window shown once memory is back");
+
+    deinit();
+    return test_result("heap");
+}
@@ -0,0 +1,278 @@
+//
+//  forecast_test.js
+//  Runs the phone side of a refresh against a local stand-in for forecast.io and the
+//  geocoder, serving the recorded payloads in fixtures/. Checks the request leaves out the
+//  blocks the watch never uses, that parseForecast() pulls out the right record and rejects
+//  bad answers, and reports bytes transferred and parse time per refresh, trimmed and not.
+//  Also checks that a key the full outbox refuses is forgotten, and how the watch's latency
+//  histogram prints from its event log.
+//
+//  node forecast_test.js
+//
+
+"use strict";
+
+var fs = require("fs");
+var http = require("http");
+var path = require("path");
+var vm = require("vm");
+
+var APP_JS = path.join(__dirname, "..", "..", "src", "js", "pebble-js-app.js");
+var FIXTURES = path.join(__dirname, "fixtures");
+var PARSE_RUNS = 200;
+
+var fixtures = {
+    "london" : fs.readFileSync(path.join(FIXTURES, "forecast-london.json"), "utf8"),
+    "tokyo"  : fs.readFileSync(path.join(FIXTURES, "forecast-tokyo.json"), "utf8")
+};
+
+var failures = 0;
+
+function expect(ok, what) {
+    if (!ok) {
+        console.log("FAIL " + what);
+        failures++;
+    }
+}
+
+// The stand-in server. Forecasts are picked by latitude and trimmed by ?exclude= the way
+// forecast.io does it; a key of "error" or "garbage" gets a failed or unparseable answer.
+var requests = [];
+
+function forecastBody(key, latitude, exclude) {
+    var body = JSON.parse(fixtures[(latitude > 45) ? "london" : "tokyo"]);
+    (exclude ? exclude.split(",") : []).forEach(function (block) {
+        delete body[block];
+    });
+    return JSON.stringify(body);
+}
+
+var server = http.createServer(function (req, res) {
+    var url = new URL(req.url, "http://localhost");
+    var parts = url.pathname.split("/");
+    var status = 200;
+    var body;
+
+    if (parts[1] === "forecast") {
+        if (parts[2] === "error") {
+            status = 500;
+            body = "";
+        } else if (parts[2] === "garbage") {
+            body = "<html>Service Unavailable</html>";
+        } else {
+            body = forecastBody(parts[2], +parts[3].split(",")[0], url.searchParams.get("exclude"));
+        }
+    } else {
+        body = JSON.stringify({ "status" : "OK", "results" : [ { "address_components" : [
+            { "long_name" : "London", "types" : [ "locality" ] },
+            { "long_name" : "United Kingdom", "types" : [ "country" ] } ] } ] });
+    }
+    requests.push({ "url" : url, "bytes" : Buffer.byteLength(body) });
+    res.writeHead(status, { "Content-Type" : "application/json" });
+    res.end(body);
+});
+
+// XMLHttpRequest as PebbleKit JS has it, sending every request to the stand-in server
+function makeXHR(port) {
+    function XHR() {
+    }
+    XHR.prototype.open = function (method, url) {
+        this.url = new URL(url);
+    };
+    XHR.prototype.send = function () {
+        var xhr = this;
+        http.get({ "host" : "127.0.0.1", "port" : port, "path" : xhr.url.pathname + xhr.url.search },
+                 function (res) {
+                     var body = "";
+                     res.setEncoding("utf8");
+                     res.on("data", function (chunk) {
+                         body += chunk;
+                     });
+                     res.on("end", function () {
+                         xhr.status = res.statusCode;
+                         xhr.responseText = body;
+                         xhr.onload({});
+                     });
+                 }).on("error", function (e) {
+                     xhr.onerror(e);
+                 });
+    };
+    return XHR;
+}
+
+// A fresh copy of the app, as PebbleKit JS loads it, with the watch's messages collected
+function loadApp(port) {
+    var storage = {};
+    var app = {
+        "sent"         : [],
+        "console"      : { "log" : function () {}, "warn" : function () {} },
+        "setTimeout"   : setTimeout,
+        "clearTimeout" : clearTimeout,
+        "XMLHttpRequest" : makeXHR(port),
+        "localStorage" : {
+            "getItem"    : function (key) {
+                return storage.hasOwnProperty(key) ? storage[key] : null;
+            },
+            "setItem"    : function (key, value) {
+                storage[key] = String(value);
+            },
+            "removeItem" : function (key) {
+                delete storage[key];
+            },
+            "key"        : function (i) {
+                return Object.keys(storage)[i];
+            },
+            get length() {
+                return Object.keys(storage).length;
+            }
+        },
+        "navigator"    : { "geolocation" : { "getCurrentPosition" : function (success) {
+            setTimeout(function () {
+                success({ "coords" : { "latitude" : 51.51, "longitude" : -0.13 } });
+            }, 0);
+        } } }
+    };
+    app.Pebble = {
+        "addEventListener" : function () {},
+        "sendAppMessage"   : function (message, ack) {
+            app.sent.push(message);
+            setTimeout(ack, 0);
+        }
+    };
+    vm.createContext(app);
+    vm.runInContext(fs.readFileSync(APP_JS, "utf8"), app, { "filename" : APP_JS });
+    vm.runInContext("getDefaults(); appData.fioKey = 'key';", app);
+    return app;
+}
+
+function requestForecast(app, key, latitude, longitude) {
+    return new Promise(function (resolve) {
+        app.appData.fioKey = key;
+        app.requestForecast(null, latitude, longitude, function (forecast, keep) {
+            resolve({ "forecast" : forecast, "keep" : keep });
+        });
+    });
+}
+
+// Refreshes every zone and waits for the batch to reach the watch
+function refresh(app) {
+    return new Promise(function (resolve) {
+        var sent = app.sent.length;
+        app.refreshAllZones();
+        (function wait() {
+            if (app.sent.length > sent) {
+                resolve(app.sent[app.sent.length - 1]);
+            } else {
+                setTimeout(wait, 1);
+            }
+        })();
+    });
+}
+
+// What parseForecast() should find in a fixture, worked out directly
+function expectedForecast(text) {
+    var doc = JSON.parse(text);
+    var daily = doc.daily.data;
+    return {
+        "icon"        : [ doc.currently.icon, daily[1].icon, daily[2].icon ],
+        "max"         : [0, 1, 2].map(function (i) { return Math.round(daily[i].temperatureMax); }),
+        "min"         : [0, 1, 2].map(function (i) { return Math.round(daily[i].temperatureMin); }),
+        "offset"      : doc.offset * 3600,
+        "timezone"    : doc.timezone,
+        "temperature" : Math.round(doc.currently.temperature)
+    };
+}
+
+function parseMs(app, text) {
+    var start = process.hrtime.bigint();
+    for (var i = 0; i < PARSE_RUNS; i++) {
+        app.parseForecast(text);
+    }
+    return Number(process.hrtime.bigint() - start) / 1e6 / PARSE_RUNS;
+}
+
+async function main() {
+    await new Promise(function (resolve) {
+        server.listen(0, "127.0.0.1", resolve);
+    });
+    var port = server.address().port;
+    var app = loadApp(port);
+    var result, query;
+
+    // The request leaves out every block the watch doesn't use
+    requests = [];
+    result = await requestForecast(app, "key", 51.51, -0.13);
+    query = requests[0].url.searchParams.get("exclude") || "";
+    ["minutely", "hourly", "alerts", "flags"].forEach(function (block) {
+        expect(query.split(",").indexOf(block) >= 0, "request excludes " + block);
+    });
+    expect(result.keep, "a good forecast is cached");
+    expect(JSON.stringify(result.forecast) ===
+           JSON.stringify(expectedForecast(forecastBody("key", 51.51, query))),
+           "parseForecast extracts the London record: " + JSON.stringify(result.forecast));
+
+    result = await requestForecast(app, "key", 35.69, 139.69);
+    expect(JSON.stringify(result.forecast) === JSON.stringify(expectedForecast(fixtures.tokyo)),
+           "parseForecast extracts the Tokyo record from the untrimmed payload too");
+
+    // Failed and unparseable answers give no record and aren't cached
+    result = await requestForecast(app, "error", 51.51, -0.13);
+    expect((result.forecast === null) && !result.keep, "HTTP error gives no forecast");
+    result = await requestForecast(app, "garbage", 51.51, -0.13);
+    expect((result.forecast === null) && !result.keep, "unparseable answer gives no forecast");
+    expect(app.parseForecast(JSON.stringify({ "offset" : 1, "currently" : {} })) === null,
+           "forecast missing its daily block is rejected");
+
+    // A whole refresh reaches the watch as one message with every zone's update
+    var perRefresh = {};
+    for (var exclude of [app.FORECAST_EXCLUDE, ""]) {
+        var fresh = loadApp(port);
+        vm.runInContext("FORECAST_EXCLUDE = " + JSON.stringify(exclude), fresh);
+        requests = [];
+        var message = await refresh(fresh);
+        var forecasts = requests.filter(function (r) {
+            return r.url.pathname.indexOf("/forecast/") === 0;
+        });
+        if (exclude) {
+            for (var zone = 0; zone < fresh.zoneCount(); zone++) {
+                expect(message.hasOwnProperty(fresh.zoneKey(zone, fresh.PBCOMM_UPDATE_KEY)),
+                       "refresh sends zone " + zone + "'s update");
+            }
+        }
+        perRefresh[exclude ? "trimmed" : "full"] = {
+            "fetches" : forecasts.length,
+            "bytes"   : forecasts.reduce(function (sum, r) { return sum + r.bytes; }, 0),
+            "parseMs" : ["london", "tokyo"].reduce(function (sum, city) {
+                return sum + parseMs(fresh, forecastBody("key", (city === "london") ? 51 : 35, exclude));
+            }, 0) / 2 * forecasts.length
+        };
+    }
+    ["full", "trimmed"].forEach(function (kind) {
+        var r = perRefresh[kind];
+        console.log("refresh, " + kind + ": " + r.fetches + " forecasts, " + r.bytes +
+                    " bytes, " + r.parseMs.toFixed(3) + " ms parsing");
+    });
+    expect(perRefresh.trimmed.bytes < perRefresh.full.bytes / 4, "trimmed refresh moves a quarter of the bytes");
+
+    // A key the full outbox refuses is forgotten, so the next refresh sends it again
+    var full = loadApp(port);
+    var refused = {};
+    vm.runInContext("outbox.inFlight = {}; outbox.count = OUTBOX_MAX_KEYS; transitionsSent[1] = '1,2';", full);
+    refused[full.zoneKey(1, full.PBCOMM_TRANSITIONS_KEY)] = [1, 2];
+    full.outboxQueue(refused);
+    expect((full.outbox.stats.dropped === 1) && (full.transitionsSent[1] === undefined),
+           "a refused key is forgotten");
+
+    // A pair of latency buckets prints as the stage, the buckets and their counts
+    var printed = [];
+    full.console.log = function (line) { printed.push(line); };
+    full.printEventLog([0, 0, 0, 0, 0x17, 4, 2, 3, 5, 0, 7, 0]);
+    expect((printed.length === 1) && / D latency, bt back, buckets 2-3, counts: 5\/7$/.test(printed[0]),
+           "latency buckets printed");
+
+    server.close();
+    console.log((failures ? "FAIL" : "PASS") + ": forecast");
+    process.exit(failures ? 1 : 0);
+}
+
+main();
@@ -0,0 +1,12 @@
+//
+//  pebble_worker.h
+//  Host stand-in for the worker SDK. The worker only uses calls the app SDK also has, so this
+//  is the same surface; stub.c implements both.
+//
+
+#ifndef PebbleWorldTime_host_pebble_worker_h
+#define PebbleWorldTime_host_pebble_worker_h
+
+#include "pebble.h"
+
+#endif
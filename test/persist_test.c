@@ -0,0 +1,49 @@
+//
+//  persist_test.c
+//  Zone state in persistent storage: state stored in an older layout is cleared at launch and
+//  the version written once there, not on every flush, and a zone's weather is only dated by
+//  messages that carry weather.
+//
+
+#include "test_util.h"
+
+#define START_TIME      1445904000      // 2015-10-27 00:00 UTC
+
+int main(void) {
+    PersistedZone old = { .gmt_sec_offset = 3600 };
+
+    // Zones stored by an older version are dropped before anything reads them
+    stub_clear_persist();
+    persist_write_int(PERSIST_VERSION_KEY, PERSIST_VERSION - 1);
+    persist_write_data(PERSIST_ZONE_KEY + 1, &old, sizeof(old));
+    stub_set_time(START_TIME, 0);
+    launch(NULL);
+    expect(persist_read_int(PERSIST_VERSION_KEY) == PERSIST_VERSION, "version recorded at launch");
+    expect(!persist_exists(PERSIST_ZONE_KEY + 1), "zone in the old layout deleted");
+    expect(watchfaces[1].gmt_sec_offset != old.gmt_sec_offset, "zone in the old layout not restored");
+
+    // A position isn't weather, so the zone's weather keeps its date
+    time_t dated = watchfaces[1].last_weather_update;
+    uint8_t location[LOCATION_LEN] = { 0x1F, 0x14, 0xF3, 0xFF };
+    stub_advance(60000);
+    stub_reset_counters();
+    send_data(1 * KEYS_PER_WATCH + PBCOMM_LOCATION_KEY, location, sizeof(location));
+    stub_advance(1000);
+    expect(watchfaces[1].last_weather_update == dated, "position doesn't date the weather");
+
+    // A v2 update does, and the flush that follows writes the zone but not the version
+    uint8_t update[UPDATE_HEADER_LEN + UPDATE_TEMPS_LEN] = {
+        [UPDATE_VERSION] = UPDATE_PROTOCOL_V2,
+        [UPDATE_SEQUENCE] = 1,
+        [UPDATE_FIELDS] = UPDATE_HAS_TEMPS,
+        [UPDATE_HEADER_LEN] = 12,
+    };
+    send_data(1 * KEYS_PER_WATCH + PBCOMM_UPDATE_KEY, update, sizeof(update));
+    stub_advance(1000);
+    expect(watchfaces[1].last_weather_update > dated, "update dates the weather");
+    stub_advance(PERSIST_DELAY_MS);
+    expect(stub_counters.persist_writes == 1, "one write for the one zone changed");
+
+    deinit();
+    return test_result("persist");
+}
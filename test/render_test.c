@@ -0,0 +1,92 @@
+//
+//  render_test.c
+//  Renders the app into the stub's counting framebuffer: how many layers each window is
+//  built from, frames and pixels touched per minute on the main and detail windows, and
+//  updates that change nothing costing no frame at all. The SDK redraws the whole window on
+//  any mark, so the frame count is what the app controls; pixels per frame show what a frame
+//  costs, and on the main window a tick only repaints the time in each row.
+//
+
+#include "test_util.h"
+
+#define SCREEN_PIXELS   (STUB_SCREEN_WIDTH * STUB_SCREEN_HEIGHT)
+
+static int count_layers(const Layer *layer) {
+    int count = 0;
+    for (const Layer *child = layer->first_child; child != NULL; child = child->next_sibling) {
+        count += 1 + count_layers(child);
+    }
+    return count;
+}
+
+// A day of ticks on the top window, reporting what each frame cost
+static void day_of_ticks(const char *window) {
+    stub_advance(60000 - (stub_now_ms() % 60000));
+    stub_reset_counters();
+    stub_advance(86400 * 1000);
+    printf("%s window, a day of ticks: %.3f frames/tick, %.0f pixels/frame (%.0f%% of the screen), "
+           "%.1f draw calls/frame\n", window,
+           (double)stub_counters.frames / stub_counters.ticks,
+           (double)stub_counters.pixels / stub_counters.frames,
+           100.0 * stub_counters.pixels / stub_counters.frames / SCREEN_PIXELS,
+           (double)stub_counters.draw_calls / stub_counters.frames);
+    // A tick changes the time, so it draws exactly once; timers that change nothing don't
+    expect(stub_counters.frames == stub_counters.ticks, "one frame per tick");
+}
+
+int main(void) {
+    launch(NULL);
+
+    int main_layers = count_layers(window_get_root_layer(mainwindow));
+    printf("main window: %d layers under the root\n", main_layers);
+    expect(main_layers == ROWS_PER_PAGE, "one layer per main window row");
+
+    day_of_ticks("main");
+
+    // A new time repaints only the time in each row; the rest stays from the last frame
+    stub_reset_counters();
+    stub_advance(60000);
+    expect((stub_counters.frames == 1) && (stub_counters.last_frame_pixels <= ROWS_PER_PAGE * 144 * 32),
+           "a tick repaints only the rows' times");
+
+    // Updates that leave every value as it was mark nothing
+    stub_reset_counters();
+    for (int i = 0; i < zone_count; i++) {
+        uint8_t icons[MAX_WEATHER_DAYS];
+        uint8_t temps[1 + 2 * MAX_WEATHER_DAYS] = { (uint8_t)watchfaces[i].temp };
+        for (int j = 0; j < MAX_WEATHER_DAYS; j++) {
+            icons[j] = watchfaces[i].icon[j];
+            temps[j+MAX_TEMPS-CURRENT_TEMP] = (uint8_t)watchfaces[i].hi_temp[j];
+            temps[j+MIN_TEMPS-CURRENT_TEMP] = (uint8_t)watchfaces[i].lo_temp[j];
+        }
+        set_icons(i, icons);
+        set_temps(i, temps);
+        update_background(&watchfaces[i], watchfaces[0].gmt_sec_offset);
+    }
+    commit_zone_changes();
+    expect((stub_counters.dirty_marks == 0) && (stub_render() == 0), "unchanged data draws nothing");
+
+    // The detail window is one layer, redrawn once a tick and once per temperature press
+    stub_click(BUTTON_ID_UP);
+    stub_advance(1000);
+    int detail_layers = count_layers(window_get_root_layer(detail->window));
+    printf("detail window: %d layers under the root\n", detail_layers);
+    expect(detail_layers == 1, "detail window is one layer");
+
+    day_of_ticks("detail");
+
+    stub_reset_counters();
+    stub_click(BUTTON_ID_SELECT);
+    printf("detail window, temperature press: %u frames, %u pixels\n",
+           (unsigned)stub_counters.frames, (unsigned)stub_counters.last_frame_pixels);
+    expect(stub_counters.frames == 1, "one frame per temperature press");
+
+    // Back on the main window every row is drawn in full, since the detail window covered them
+    stub_reset_counters();
+    stub_click(BUTTON_ID_BACK);
+    expect((window_stack_get_top_window() == mainwindow) &&
+           (stub_counters.last_frame_pixels == SCREEN_PIXELS), "main window redrawn in full on return");
+
+    deinit();
+    return test_result("render");
+}
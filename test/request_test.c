@@ -0,0 +1,98 @@
+//
+//  request_test.c
+//  Requests to the phone over the stub's link: each request that goes out carries a new ID,
+//  one left waiting on a busy outbox doesn't take one until it's sent, and the phone's timing
+//  reply is matched to the request it answers. A request left waiting behind the event log
+//  goes out once the log is through, whether the log is sent, overwritten on the way, or fails.
+//  The latency histogram is dumped into the log as records for the phone to print.
+//
+
+#include "test_util.h"
+
+// The phone: every request ID it has been sent, in order
+static uint16_t phone_ids[16];
+static int phone_requests = 0;
+
+static void phone_handler(const uint8_t *data, uint16_t size) {
+    DictionaryIterator iter;
+    dict_read_begin_from_buffer(&iter, (uint8_t *)data, size);
+    Tuple *id = dict_find(&iter, PBCOMM_REQUEST_ID_KEY);
+    if ((id != NULL) && (phone_requests < 16)) {
+        phone_ids[phone_requests++] = id->value->uint16;
+    }
+}
+
+static void phone_reply_timing(uint16_t id) {
+    uint8_t timing[TIMING_LEN] = { id & 0xFF, id >> 8, 0, 0, 0, 0, 10, 0 };
+    send_data(PBCOMM_TIMING_KEY, timing, sizeof(timing));
+}
+
+static uint32_t latencies_recorded(RequestStage stage) {
+    uint32_t total = 0;
+    for (int b = 0; b < LATENCY_BUCKETS; b++) {
+        total += request_timing.histogram[stage][b];
+    }
+    return total;
+}
+
+int main(void) {
+    launch(phone_handler);
+    stub_advance(59 * 1000);
+    stub_reset_counters();
+    phone_requests = 0;
+
+    // A request made while the last one is still in the outbox waits, keeping its ID unused
+    request_update_from_phone(REQUEST_UPDATE);
+    uint16_t sent_id = request_timing.id;
+    request_update_from_phone(REQUEST_UPDATE);
+    expect(stub_counters.outbox_busy == 1, "second request finds the outbox busy");
+    expect(request_timing.id == sent_id, "a request that wasn't sent takes no ID");
+    expect((phone_requests == 1) && (phone_ids[0] == sent_id), "phone has the sent request's ID");
+
+    // The phone's reply to the request it got is matched and timed
+    stub_advance(1000);
+    phone_reply_timing(phone_ids[0]);
+    stub_advance(1000);
+    expect(request_timing.timeout == NULL, "reply to the sent request ends its timeout");
+    expect(latencies_recorded(STAGE_BT_BACK) == 1, "reply to the sent request is timed");
+#if EVENT_LOG_LEVEL >= EVENT_LEVEL_DEBUG
+    latency_dump();
+    LogRecord *last = &event_log_records[(event_log_first + event_log_count - 1) % EVENT_LOG_SIZE];
+    expect((last->event == EVENT_LATENCY_BUCKETS) && ((last->a >> 8) == STAGE_BT_BACK) &&
+           ((uint16_t)last->b + ((uint32_t)last->b >> 16) == 1),
+           "latency dump logs the timed stage's buckets");
+#endif
+
+    // The next request that goes out takes the next ID
+    request_update_from_phone(REQUEST_UPDATE);
+    expect((phone_requests == 2) && (phone_ids[1] == (uint16_t)(sent_id + 1)),
+           "next request sent takes the next ID");
+    stub_advance(1000);
+
+    // The log's ACK sends a request left waiting behind it, even once the records it carried
+    // have been overwritten, and isn't taken for the request's own ACK
+    event_log(EVENT_LEVEL_WARNING, EVENT_INBOX_DROPPED, 0, 0);
+    event_log_flush();
+    request_update_from_phone(REQUEST_UPDATE);
+    for (int i = 0; i <= EVENT_LOG_SIZE; i++) {
+        event_log(EVENT_LEVEL_WARNING, EVENT_INBOX_DROPPED, 0, i);
+    }
+    stub_advance(300);
+    expect((phone_requests == 3) && (phone_ids[2] == (uint16_t)(sent_id + 2)),
+           "request waiting behind an overwritten log goes out after it");
+    expect((request_pending != 0) && (request_timing.bt_out_ms == 0),
+           "log's ACK isn't taken for the request's");
+    stub_advance(1000);
+    expect(request_pending == 0, "request's own ACK ends it");
+
+    // A log that fails to go out leaves the request waiting behind it to be retried
+    stub_fail_next_send(APP_MSG_SEND_TIMEOUT);
+    event_log_flush();
+    request_update_from_phone(REQUEST_UPDATE);
+    stub_advance(REQUEST_RETRY_MS + 1000);
+    expect((phone_requests == 4) && (phone_ids[3] == (uint16_t)(sent_id + 3)),
+           "request waiting behind a failed log is retried");
+
+    deinit();
+    return test_result("request");
+}
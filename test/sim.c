@@ -0,0 +1,235 @@
+//
+//  sim.c
+//  Runs a week of the app in a few seconds on the stub's mock clock and AppMessage link: minute
+//  ticks, sunrises and sunsets, date rollovers, the watch's own fall back to standard time, a
+//  phone that answers each request with weather after a realistic delay, a couple of hours
+//  out of Bluetooth range, and a glance at the detail window now and then. Reports totals for
+//  the week and the energy score built from the app's PERF_COST weights, so builds can be
+//  compared on the workload that matters.
+//
+//  sim
+//
+
+#include "test_util.h"
+
+#define SIM_START       1445904000      // 2015-10-27 00:00 UTC, a Tuesday
+#define SIM_DAYS        7
+#define SIM_ZONES       3
+#define FALL_BACK       1446368400      // 2015-11-01 09:00 UTC, Los Angeles leaves PDT
+#define OUT_OF_RANGE    (SIM_START + 3 * 86400 + 13 * 3600)     // for two hours
+#define PHONE_GEOLOCATION_MS    800
+#define PHONE_HTTP_MS           1200
+#define PHONE_REPLY_MS          (PHONE_GEOLOCATION_MS + PHONE_HTTP_MS + 400)
+#define GLANCE_EVERY    (90 * 60)       // seconds between looks at the detail window, awake
+#define GLANCE_SECS     8
+
+typedef struct {
+    const char  *city;
+    int32_t      offset;
+    int16_t      latitude;              // hundredths of a degree
+    int16_t      longitude;
+    int8_t       temp;                  // around which the weather wanders
+} SimZone;
+
+static const SimZone sim_zones[SIM_ZONES] = {
+    { "Los Angeles, CA", -25200, 3405, -11824, 20 },
+    { "London, England",      0, 5151,    -13, 11 },
+    { "Tokyo, Japan",     32400, 3569,  13969, 17 },
+};
+
+// The phone's side: a reply waiting on geolocation and HTTP, and what it's sent each zone
+static struct {
+    bool         reply_due;
+    uint64_t     reply_at_ms;
+    uint16_t     request_id;
+    bool         full;
+    uint64_t     received_ms;
+    uint8_t      sequence[SIM_ZONES];
+    bool         sent_once;
+    uint32_t     requests;
+    uint32_t     replies;
+} phone;
+
+static void phone_handler(const uint8_t *data, uint16_t size) {
+    DictionaryIterator iter;
+    dict_read_begin_from_buffer(&iter, (uint8_t *)data, size);
+    Tuple *request = dict_find(&iter, PBCOMM_REQUEST_KEY);
+    Tuple *id = dict_find(&iter, PBCOMM_REQUEST_ID_KEY);
+
+    if (request == NULL) {
+        return;                         // the event log, read and thrown away
+    }
+    phone.requests++;
+    phone.reply_due = true;
+    phone.received_ms = stub_now_ms();
+    phone.reply_at_ms = phone.received_ms + PHONE_REPLY_MS;
+    phone.request_id = (id != NULL) ? id->value->uint16 : 0;
+    phone.full = phone.full || (request->value->uint8 == REQUEST_FULL_UPDATE) || !phone.sent_once;
+}
+
+static void put_uint16(uint8_t *p, uint16_t value) {
+    p[0] = value & 0xFF;
+    p[1] = value >> 8;
+}
+
+// Weather that drifts through the day: warmest mid-afternoon, the icon changing every few hours
+static void zone_weather(int z, uint8_t *icons, uint8_t *temps) {
+    time_t now = stub_now();
+    int hour = (int)(((now + sim_zones[z].offset) % 86400) / 3600);
+    int day = (int)((now - SIM_START) / 86400);
+    int8_t temp = sim_zones[z].temp + ((hour >= 9) && (hour <= 18) ? (hour - 9) / 2 : 0);
+
+    for (int j = 0; j < MAX_WEATHER_DAYS; j++) {
+        icons[j] = 1 + ((day + j + z + (hour / 4)) % 9);
+    }
+    temps[0] = (uint8_t)temp;
+    for (int j = 0; j < MAX_WEATHER_DAYS; j++) {
+        temps[1 + j] = (uint8_t)(sim_zones[z].temp + 5 + ((day + j) % 3));
+        temps[1 + MAX_WEATHER_DAYS + j] = (uint8_t)(sim_zones[z].temp - 4 - ((day + j) % 2));
+    }
+}
+
+static void phone_reply(void) {
+    uint8_t buffer[512];
+    DictionaryIterator iter;
+
+    dict_write_begin(&iter, buffer, sizeof(buffer));
+    if (phone.full) {
+        dict_write_uint8(&iter, PBCOMM_ZONE_COUNT_KEY, SIM_ZONES);
+    }
+    for (int z = 0; z < SIM_ZONES; z++) {
+        uint8_t update[UPDATE_HEADER_LEN + 4 + 1 + 1 + UPDATE_ICONS_LEN + UPDATE_TEMPS_LEN + 1 + MAX_CITY_LEN];
+        uint8_t *p = &update[UPDATE_HEADER_LEN];
+        uint8_t fields = UPDATE_HAS_ICONS | UPDATE_HAS_TEMPS;
+
+        if (phone.full) {
+            int32_t offset = sim_zones[z].offset;
+            if ((z == 0) && (stub_now() >= FALL_BACK)) {
+                offset -= 3600;
+            }
+            fields |= UPDATE_FULL | UPDATE_HAS_OFFSET | UPDATE_HAS_BACKGROUND | UPDATE_HAS_DISPLAY |
+                      UPDATE_HAS_CITY;
+            for (int b = 0; b < 4; b++) {
+                *p++ = ((uint32_t)offset >> (8 * b)) & 0xFF;
+            }
+            *p++ = BACKGROUND_SUNS;
+            *p++ = DISPLAY_WATCH_CONFIG_TIME;
+        }
+        zone_weather(z, p, p + UPDATE_ICONS_LEN);
+        p += UPDATE_ICONS_LEN + UPDATE_TEMPS_LEN;
+        if (phone.full) {
+            size_t len = strlen(sim_zones[z].city);
+            *p++ = (uint8_t)len;
+            memcpy(p, sim_zones[z].city, len);
+            p += len;
+        }
+        update[UPDATE_VERSION] = UPDATE_PROTOCOL_V2;
+        update[UPDATE_SEQUENCE] = ++phone.sequence[z];
+        update[UPDATE_FIELDS] = fields;
+        dict_write_data(&iter, z * KEYS_PER_WATCH + PBCOMM_UPDATE_KEY, update, p - update);
+
+        if (phone.full) {
+            uint8_t location[LOCATION_LEN];
+            put_uint16(&location[LOCATION_LATITUDE], (uint16_t)sim_zones[z].latitude);
+            put_uint16(&location[LOCATION_LONGITUDE], (uint16_t)sim_zones[z].longitude);
+            dict_write_data(&iter, z * KEYS_PER_WATCH + PBCOMM_LOCATION_KEY, location, sizeof(location));
+        }
+    }
+    if (phone.full && (stub_now() < FALL_BACK)) {
+        uint8_t transition[TRANSITION_LEN] = {
+            FALL_BACK & 0xFF, (FALL_BACK >> 8) & 0xFF, (FALL_BACK >> 16) & 0xFF, (FALL_BACK >> 24) & 0xFF,
+            (uint8_t)(int8_t)((sim_zones[0].offset - 3600) / 900)
+        };
+        dict_write_data(&iter, PBCOMM_TRANSITIONS_KEY, transition, sizeof(transition));
+    }
+    uint8_t timing[TIMING_LEN];
+    put_uint16(&timing[TIMING_REQUEST_ID], phone.request_id);
+    put_uint16(&timing[TIMING_GEOLOCATION], PHONE_GEOLOCATION_MS);
+    put_uint16(&timing[TIMING_HTTP], PHONE_HTTP_MS);
+    put_uint16(&timing[TIMING_PHONE], (uint16_t)(stub_now_ms() - phone.received_ms));
+    dict_write_data(&iter, PBCOMM_TIMING_KEY, timing, sizeof(timing));
+
+    stub_send_to_watch(buffer, dict_write_end(&iter));
+    phone.reply_due = false;
+    phone.full = false;
+    phone.sent_once = true;
+    phone.replies++;
+}
+
+// Someone looks at a zone's weather now and then while awake (07:00 to 23:00 on the watch)
+static void glance(void) {
+    int32_t local = (int32_t)((stub_now() + watchfaces[0].gmt_sec_offset) % 86400);
+    if ((local < 7 * 3600) || (local >= 23 * 3600)) {
+        return;
+    }
+    stub_click(BUTTON_ID_UP);
+    stub_advance(GLANCE_SECS * 1000);
+    stub_click(BUTTON_ID_BACK);
+}
+
+int main(void) {
+    stub_clear_persist();
+    stub_set_time(SIM_START, 0);
+    stub_set_utc_offset(sim_zones[0].offset);
+    stub_set_phone(phone_handler);
+    init();
+    stub_reset_counters();
+
+    time_t next_glance = SIM_START + GLANCE_EVERY;
+    bool fallen_back = false;
+    bool out_of_range = false;
+    while (stub_now() < SIM_START + SIM_DAYS * 86400) {
+        time_t now = stub_now();
+        if (!fallen_back && (now >= FALL_BACK)) {
+            stub_set_utc_offset(sim_zones[0].offset - 3600);
+            fallen_back = true;
+        }
+        bool gone = (now >= OUT_OF_RANGE) && (now < OUT_OF_RANGE + 2 * 3600);
+        if (gone != out_of_range) {
+            out_of_range = gone;
+            stub_set_connected(!gone);
+        }
+        stub_advance(1000);
+        if (phone.reply_due && (stub_now_ms() >= phone.reply_at_ms)) {
+            phone_reply();
+        }
+        if (stub_now() >= next_glance) {
+            glance();
+            next_glance += GLANCE_EVERY;
+        }
+    }
+    deinit();
+
+    StubCounters *c = &stub_counters;
+    uint64_t energy = (uint64_t)c->wakeups * PERF_COST_WAKEUP +
+                      (uint64_t)(c->localtime_calls + c->strftime_calls) * PERF_COST_TIME_CALL +
+                      (uint64_t)c->dirty_marks * PERF_COST_REDRAW +
+                      (uint64_t)(c->messages_in + c->messages_out) * PERF_COST_MESSAGE +
+                      (uint64_t)(c->bytes_in + c->bytes_out) * PERF_COST_BYTE;
+
+    printf("%d simulated days, %d zones\n", SIM_DAYS, SIM_ZONES);
+    printf("  wakeups           %10u  (ticks %u, timers %u)\n", c->wakeups, c->ticks, c->timers_fired);
+    printf("  localtime calls   %10u\n", c->localtime_calls);
+    printf("  strftime calls    %10u\n", c->strftime_calls);
+    printf("  layers dirtied    %10u  (frames %u)\n", c->dirty_marks, c->frames);
+    printf("  messages out      %10u  (%u bytes, %u requests answered of %u)\n", c->messages_out,
+           c->bytes_out, phone.replies, phone.requests);
+    printf("  messages in       %10u  (%u bytes)\n", c->messages_in, c->bytes_in);
+    printf("  persist writes    %10u  (%u bytes)\n", c->persist_writes, c->persist_bytes);
+    printf("  energy score      %10llu  (%llu per day)\n", (unsigned long long)energy,
+           (unsigned long long)(energy / SIM_DAYS));
+
+    if (c->ticks != SIM_DAYS * 1440) {
+        printf("FAIL %u ticks handled, expected %d\n", c->ticks, SIM_DAYS * 1440);
+        failures++;
+    }
+    if (watchfaces[0].gmt_sec_offset != sim_zones[0].offset - 3600) {
+        printf("FAIL the watch's zone didn't fall back: %d\n", (int)watchfaces[0].gmt_sec_offset);
+        failures++;
+    }
+    if (phone.requests < SIM_DAYS * 24) {
+        printf("FAIL only %u requests in a week\n", phone.requests);
+        failures++;
+    }
+    return test_result("sim");
+}
@@ -0,0 +1,1339 @@
+//
+//  stub.c
+//  Host implementation of pebble.h, see stub.h. Linked with --wrap for time(), localtime(),
+//  strftime(), malloc() and free() so the app's own calls are counted and use the mock clock.
+//
+
+#include <math.h>
+#include <stdarg.h>
+#include "stub.h"
+
+StubCounters stub_counters;
+
+void stub_reset_counters(void) {
+    memset(&stub_counters, 0, sizeof(stub_counters));
+}
+
+// Heap
+
+void *__real_malloc(size_t size);
+void __real_free(void *ptr);
+
+typedef struct {
+    size_t size;
+    size_t pad;                         // keeps the caller's block 16-byte aligned
+} HeapHeader;
+
+static size_t heap_used = 0;
+static size_t heap_peak = 0;
+static int    malloc_fail_at = 0;
+
+#ifdef PBL_PLATFORM_APLITE
+#define STUB_HEAP_SIZE      24576
+#else
+#define STUB_HEAP_SIZE      65536
+#endif
+
+void *__wrap_malloc(size_t size) {
+    if ((malloc_fail_at > 0) && (--malloc_fail_at == 0)) {
+        return NULL;
+    }
+    HeapHeader *header = __real_malloc(sizeof(HeapHeader) + size);
+    if (header == NULL) {
+        return NULL;
+    }
+    header->size = size;
+    heap_used += size;
+    if (heap_used > heap_peak) {
+        heap_peak = heap_used;
+    }
+    stub_counters.allocs++;
+    return header + 1;
+}
+
+void __wrap_free(void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+    HeapHeader *header = (HeapHeader *)ptr - 1;
+    heap_used -= header->size;
+    stub_counters.frees++;
+    __real_free(header);
+}
+
+size_t heap_bytes_used(void) {
+    return heap_used;
+}
+
+size_t heap_bytes_free(void) {
+    return (heap_used < STUB_HEAP_SIZE) ? STUB_HEAP_SIZE - heap_used : 0;
+}
+
+size_t stub_heap_peak(void) {
+    return heap_peak;
+}
+
+void stub_reset_heap_peak(void) {
+    heap_peak = heap_used;
+}
+
+void stub_fail_malloc(int nth) {
+    malloc_fail_at = nth;
+}
+
+// Clock
+
+time_t __real_time(time_t *tloc);
+size_t __real_strftime(char *s, size_t max, const char *format, const struct tm *tm);
+
+static uint64_t now_ms = 1444176000000ULL;      // 2015-10-07 00:00 UTC
+static int32_t  utc_offset = -25200;            // the watch's zone, PDT
+static bool     is_24h_style = false;
+
+void stub_set_time(time_t utc, uint16_t ms) {
+    now_ms = (uint64_t)utc * 1000 + ms;
+}
+
+void stub_set_utc_offset(int32_t secs) {
+    utc_offset = secs;
+}
+
+void stub_set_24h_style(bool is_24h) {
+    is_24h_style = is_24h;
+}
+
+time_t stub_now(void) {
+    return (time_t)(now_ms / 1000);
+}
+
+uint64_t stub_now_ms(void) {
+    return now_ms;
+}
+
+static struct tm *watch_localtime(time_t utc, struct tm *result) {
+    time_t local = utc + utc_offset;
+    gmtime_r(&local, result);
+    result->tm_gmtoff = utc_offset;
+    return result;
+}
+
+time_t __wrap_time(time_t *tloc) {
+    time_t now = stub_now();
+    stub_counters.time_calls++;
+    if (tloc != NULL) {
+        *tloc = now;
+    }
+    return now;
+}
+
+struct tm *__wrap_localtime(const time_t *timep) {
+    static struct tm result;
+    stub_counters.localtime_calls++;
+    return watch_localtime(*timep, &result);
+}
+
+size_t __wrap_strftime(char *s, size_t max, const char *format, const struct tm *tm) {
+    stub_counters.strftime_calls++;
+    return __real_strftime(s, max, format, tm);
+}
+
+uint16_t time_ms(time_t *tloc, uint16_t *out_ms) {
+    uint16_t ms = (uint16_t)(now_ms % 1000);
+    if (tloc != NULL) {
+        *tloc = stub_now();
+    }
+    if (out_ms != NULL) {
+        *out_ms = ms;
+    }
+    return ms;
+}
+
+bool clock_is_24h_style(void) {
+    return is_24h_style;
+}
+
+// Logging
+
+void app_log(uint8_t log_level, const char *src_filename, int src_line_number, const char *fmt, ...) {
+    static bool verbose = false;
+    static bool checked = false;
+    if (!checked) {
+        verbose = (getenv("STUB_VERBOSE") != NULL);
+        checked = true;
+    }
+    if (!verbose) {
+        return;
+    }
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "%s:%d ", src_filename, src_line_number);
+    vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
+
+// Trigonometry, exact and rounded to TRIG_MAX_RATIO. The firmware reads a table, and the
+// error that adds isn't modelled here.
+
+int32_t sin_lookup(int32_t angle) {
+    return (int32_t)lround(sin(angle * 2 * M_PI / TRIG_MAX_ANGLE) * TRIG_MAX_RATIO);
+}
+
+int32_t cos_lookup(int32_t angle) {
+    return (int32_t)lround(cos(angle * 2 * M_PI / TRIG_MAX_ANGLE) * TRIG_MAX_RATIO);
+}
+
+// Graphics. Each frame keeps a map of the pixels draw calls touched; text counts its whole
+// box, so it's an upper bound on what a glyph renderer would write.
+
+struct GContext {
+    GRect        clip;                  // screen coordinates
+    GPoint       origin;                // of the layer being drawn
+    GColor       fill_color;
+    GColor       text_color;
+    GCompOp      compositing_mode;
+};
+
+struct GBitmap {
+    GRect        bounds;
+    bool         owns_data;
+};
+
+struct GFontDescriptor {
+    const char  *key;
+    int          height;
+};
+
+static uint8_t touched[STUB_SCREEN_HEIGHT][STUB_SCREEN_WIDTH];
+static uint32_t frame_pixels;
+
+static GRect grect_intersect(GRect a, GRect b) {
+    int x0 = (a.origin.x > b.origin.x) ? a.origin.x : b.origin.x;
+    int y0 = (a.origin.y > b.origin.y) ? a.origin.y : b.origin.y;
+    int x1 = ((a.origin.x + a.size.w) < (b.origin.x + b.size.w)) ? a.origin.x + a.size.w : b.origin.x + b.size.w;
+    int y1 = ((a.origin.y + a.size.h) < (b.origin.y + b.size.h)) ? a.origin.y + a.size.h : b.origin.y + b.size.h;
+    if ((x1 <= x0) || (y1 <= y0)) {
+        return GRect(0, 0, 0, 0);
+    }
+    return GRect(x0, y0, x1 - x0, y1 - y0);
+}
+
+static void touch(GContext *ctx, GRect rect) {
+    stub_counters.draw_calls++;
+    rect.origin.x += ctx->origin.x;
+    rect.origin.y += ctx->origin.y;
+    rect = grect_intersect(rect, ctx->clip);
+    for (int y = rect.origin.y; y < rect.origin.y + rect.size.h; y++) {
+        for (int x = rect.origin.x; x < rect.origin.x + rect.size.w; x++) {
+            if (!touched[y][x]) {
+                touched[y][x] = 1;
+                frame_pixels++;
+            }
+        }
+    }
+}
+
+bool gcolor_equal(GColor8 x, GColor8 y) {
+    return x.argb == y.argb;
+}
+
+GFont fonts_get_system_font(const char *font_key) {
+    static struct GFontDescriptor fonts[] = {
+        { FONT_KEY_BITHAM_30_BLACK, 30 },
+        { FONT_KEY_GOTHIC_14, 14 },
+        { FONT_KEY_GOTHIC_18_BOLD, 18 },
+        { FONT_KEY_GOTHIC_24_BOLD, 24 },
+    };
+    for (size_t i = 0; i < sizeof(fonts) / sizeof(fonts[0]); i++) {
+        if (strcmp(fonts[i].key, font_key) == 0) {
+            return &fonts[i];
+        }
+    }
+    return &fonts[0];
+}
+
+void graphics_context_set_fill_color(GContext *ctx, GColor color) {
+    ctx->fill_color = color;
+}
+
+void graphics_context_set_text_color(GContext *ctx, GColor color) {
+    ctx->text_color = color;
+}
+
+void graphics_context_set_compositing_mode(GContext *ctx, GCompOp mode) {
+    ctx->compositing_mode = mode;
+}
+
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius, GCornerMask corner_mask) {
+    touch(ctx, rect);
+}
+
+void graphics_draw_text(GContext *ctx, const char *text, GFont const font, const GRect box,
+                        const GTextOverflowMode overflow_mode, const GTextAlignment alignment,
+                        GTextAttributes *text_attributes) {
+    if ((text != NULL) && (text[0] != '\0')) {
+        touch(ctx, box);
+    }
+}
+
+void graphics_draw_bitmap_in_rect(GContext *ctx, const GBitmap *bitmap, GRect rect) {
+    if (rect.size.w > bitmap->bounds.size.w) {
+        rect.size.w = bitmap->bounds.size.w;
+    }
+    if (rect.size.h > bitmap->bounds.size.h) {
+        rect.size.h = bitmap->bounds.size.h;
+    }
+    touch(ctx, rect);
+}
+
+void grect_align(GRect *rect, const GRect *inside_rect, const GAlign alignment, const bool clip) {
+    rect->origin.x = inside_rect->origin.x + (inside_rect->size.w - rect->size.w) / 2;
+    rect->origin.y = inside_rect->origin.y + (inside_rect->size.h - rect->size.h) / 2;
+    if (clip) {
+        *rect = grect_intersect(*rect, *inside_rect);
+    }
+}
+
+// Resources, by ID: the size of each bitmap
+
+static const GSize resource_sizes[] = {
+    { 0, 0 },
+    { 36, 360 },                        // RESOURCE_ID_WEATHER_ATLAS, ten 36px cells
+};
+
+GBitmap *gbitmap_create_with_resource(uint32_t resource_id) {
+    GSize size = resource_sizes[resource_id];
+#ifdef PBL_PLATFORM_APLITE
+    size_t data = ((size.w + 31) / 32) * 4 * size.h;   // 1 bit, rows padded to words
+#else
+    size_t data = size.w * size.h;                      // 1 byte a pixel
+#endif
+    GBitmap *bitmap = malloc(sizeof(GBitmap) + data);
+    if (bitmap == NULL) {
+        return NULL;
+    }
+    bitmap->bounds = GRect(0, 0, size.w, size.h);
+    bitmap->owns_data = true;
+    return bitmap;
+}
+
+GBitmap *gbitmap_create_as_sub_bitmap(const GBitmap *base_bitmap, GRect sub_rect) {
+    GBitmap *bitmap = malloc(sizeof(GBitmap));
+    if (bitmap == NULL) {
+        return NULL;
+    }
+    bitmap->bounds = GRect(0, 0, sub_rect.size.w, sub_rect.size.h);
+    bitmap->owns_data = false;
+    return bitmap;
+}
+
+GRect gbitmap_get_bounds(const GBitmap *bitmap) {
+    return bitmap->bounds;
+}
+
+void gbitmap_destroy(GBitmap *bitmap) {
+    free(bitmap);
+}
+
+// Layers
+
+static Window *layer_window(const Layer *layer) {
+    while (layer->parent != NULL) {
+        layer = layer->parent;
+    }
+    return layer->window;
+}
+
+static void layer_init(Layer *layer, GRect frame) {
+    memset(layer, 0, sizeof(*layer));
+    layer->frame = frame;
+    layer->bounds = GRect(0, 0, frame.size.w, frame.size.h);
+}
+
+Layer *layer_create(GRect frame) {
+    return layer_create_with_data(frame, 0);
+}
+
+Layer *layer_create_with_data(GRect frame, size_t data_size) {
+    Layer *layer = malloc(sizeof(Layer) + data_size);
+    if (layer == NULL) {
+        return NULL;
+    }
+    layer_init(layer, frame);
+    layer->data = (data_size > 0) ? (void *)(layer + 1) : NULL;
+    return layer;
+}
+
+void layer_remove_from_parent(Layer *child) {
+    Layer *parent = child->parent;
+    if (parent == NULL) {
+        return;
+    }
+    for (Layer **link = &parent->first_child; *link != NULL; link = &(*link)->next_sibling) {
+        if (*link == child) {
+            *link = child->next_sibling;
+            break;
+        }
+    }
+    child->parent = NULL;
+    child->next_sibling = NULL;
+}
+
+void layer_destroy(Layer *layer) {
+    if (layer == NULL) {
+        return;
+    }
+    layer_remove_from_parent(layer);
+    for (Layer *child = layer->first_child; child != NULL; child = child->next_sibling) {
+        child->parent = NULL;
+    }
+    free(layer);
+}
+
+void layer_mark_dirty(Layer *layer) {
+    stub_counters.dirty_marks++;
+    Window *window = layer_window(layer);
+    if (window != NULL) {
+        window->layer.dirty = true;
+    }
+}
+
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc) {
+    layer->update_proc = update_proc;
+}
+
+void layer_add_child(Layer *parent, Layer *child) {
+    Layer **link = &parent->first_child;
+    layer_remove_from_parent(child);
+    while (*link != NULL) {
+        link = &(*link)->next_sibling;
+    }
+    *link = child;
+    child->parent = parent;
+}
+
+GRect layer_get_bounds(const Layer *layer) {
+    return layer->bounds;
+}
+
+GRect layer_get_frame(const Layer *layer) {
+    return layer->frame;
+}
+
+void layer_set_hidden(Layer *layer, bool hidden) {
+    if (layer->hidden != hidden) {
+        layer->hidden = hidden;
+        if (layer->parent != NULL) {
+            layer_mark_dirty(layer->parent);
+        }
+    }
+}
+
+bool layer_get_hidden(const Layer *layer) {
+    return layer->hidden;
+}
+
+void *layer_get_data(const Layer *layer) {
+    return layer->data;
+}
+
+static void text_layer_update_proc(Layer *layer, GContext *ctx) {
+    TextLayer *text_layer = (TextLayer *)layer;
+    if (text_layer->background_color.argb != GColorClear.argb) {
+        graphics_fill_rect(ctx, layer->bounds, 0, GCornerNone);
+    }
+    graphics_draw_text(ctx, text_layer->text, text_layer->font, layer->bounds,
+                       text_layer->overflow_mode, text_layer->alignment, NULL);
+}
+
+TextLayer *text_layer_create(GRect frame) {
+    TextLayer *text_layer = malloc(sizeof(TextLayer));
+    if (text_layer == NULL) {
+        return NULL;
+    }
+    memset(text_layer, 0, sizeof(*text_layer));
+    layer_init(&text_layer->layer, frame);
+    text_layer->layer.update_proc = text_layer_update_proc;
+    text_layer->text_color = GColorBlack;
+    text_layer->background_color = GColorWhite;
+    text_layer->font = fonts_get_system_font(FONT_KEY_GOTHIC_14);
+    return text_layer;
+}
+
+void text_layer_destroy(TextLayer *text_layer) {
+    layer_destroy(&text_layer->layer);
+}
+
+Layer *text_layer_get_layer(TextLayer *text_layer) {
+    return &text_layer->layer;
+}
+
+void text_layer_set_text(TextLayer *text_layer, const char *text) {
+    text_layer->text = text;
+    layer_mark_dirty(&text_layer->layer);
+}
+
+void text_layer_set_font(TextLayer *text_layer, GFont font) {
+    text_layer->font = font;
+}
+
+void text_layer_set_text_color(TextLayer *text_layer, GColor color) {
+    text_layer->text_color = color;
+}
+
+void text_layer_set_background_color(TextLayer *text_layer, GColor color) {
+    text_layer->background_color = color;
+}
+
+void text_layer_set_text_alignment(TextLayer *text_layer, GTextAlignment text_alignment) {
+    text_layer->alignment = text_alignment;
+}
+
+// Windows
+
+#define STUB_MAX_WINDOWS    8
+
+static Window *window_stack[STUB_MAX_WINDOWS];
+static int     window_stack_count = 0;
+static Window *configuring = NULL;      // whose click config the subscribe calls fill in
+
+Window *window_create(void) {
+    Window *window = malloc(sizeof(Window));
+    if (window == NULL) {
+        return NULL;
+    }
+    memset(window, 0, sizeof(*window));
+    layer_init(&window->layer, GRect(0, 0, STUB_SCREEN_WIDTH, STUB_SCREEN_HEIGHT));
+    window->layer.window = window;
+    window->background_color = GColorWhite;
+    return window;
+}
+
+Layer *window_get_root_layer(const Window *window) {
+    return (Layer *)&window->layer;
+}
+
+void window_set_background_color(Window *window, GColor background_color) {
+    window->background_color = background_color;
+}
+
+void window_set_click_config_provider(Window *window, ClickConfigProvider click_config_provider) {
+    window_set_click_config_provider_with_context(window, click_config_provider, window);
+}
+
+void window_set_click_config_provider_with_context(Window *window,
+                                                   ClickConfigProvider click_config_provider,
+                                                   void *context) {
+    window->click_config_provider = click_config_provider;
+    window->click_config_context = context;
+}
+
+void window_set_window_handlers(Window *window, WindowHandlers handlers) {
+    window->window_handlers = handlers;
+}
+
+void window_single_click_subscribe(ButtonId button_id, ClickHandler handler) {
+    configuring->single_click[button_id] = handler;
+}
+
+void window_long_click_subscribe(ButtonId button_id, uint16_t delay_ms, ClickHandler down_handler,
+                                 ClickHandler up_handler) {
+    configuring->long_click[button_id] = down_handler;
+}
+
+Window *window_stack_get_top_window(void) {
+    return (window_stack_count > 0) ? window_stack[window_stack_count - 1] : NULL;
+}
+
+bool window_stack_contains_window(Window *window) {
+    for (int i = 0; i < window_stack_count; i++) {
+        if (window_stack[i] == window) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void window_show(Window *window) {
+    memset(window->single_click, 0, sizeof(window->single_click));
+    memset(window->long_click, 0, sizeof(window->long_click));
+    if (window->click_config_provider != NULL) {
+        configuring = window;
+        window->click_config_provider(window->click_config_context);
+        configuring = NULL;
+    }
+    window->on_screen = true;
+    window->layer.dirty = true;
+    if (window->window_handlers.appear != NULL) {
+        window->window_handlers.appear(window);
+    }
+}
+
+static void window_hide(Window *window) {
+    if (!window->on_screen) {
+        return;
+    }
+    window->on_screen = false;
+    if (window->window_handlers.disappear != NULL) {
+        window->window_handlers.disappear(window);
+    }
+}
+
+static void window_unload(Window *window) {
+    window->loaded = false;
+    if (window->window_handlers.unload != NULL) {
+        window->window_handlers.unload(window);
+    }
+}
+
+void window_stack_push(Window *window, bool animated) {
+    Window *top = window_stack_get_top_window();
+    if (window_stack_contains_window(window) || (window_stack_count == STUB_MAX_WINDOWS)) {
+        return;
+    }
+    window_stack[window_stack_count++] = window;
+    if (!window->loaded) {
+        window->loaded = true;
+        if (window->window_handlers.load != NULL) {
+            window->window_handlers.load(window);
+        }
+    }
+    if (top != NULL) {
+        window_hide(top);
+    }
+    window_show(window);
+}
+
+bool window_stack_remove(Window *window, bool animated) {
+    int i;
+    for (i = 0; (i < window_stack_count) && (window_stack[i] != window); i++) {
+    }
+    if (i == window_stack_count) {
+        return false;
+    }
+    bool was_top = (i == window_stack_count - 1);
+    if (was_top) {
+        window_hide(window);
+    }
+    memmove(&window_stack[i], &window_stack[i + 1], (window_stack_count - i - 1) * sizeof(Window *));
+    window_stack_count--;
+    window_unload(window);
+    if (was_top && (window_stack_count > 0)) {
+        window_show(window_stack_get_top_window());
+    }
+    return true;
+}
+
+Window *window_stack_pop(bool animated) {
+    Window *top = window_stack_get_top_window();
+    if (top != NULL) {
+        window_stack_remove(top, animated);
+    }
+    return top;
+}
+
+void window_stack_pop_all(const bool animated) {
+    while (window_stack_count > 0) {
+        window_stack_pop(animated);
+    }
+}
+
+void window_destroy(Window *window) {
+    if (window == NULL) {
+        return;
+    }
+    window_stack_remove(window, false);
+    for (Layer *child = window->layer.first_child; child != NULL; child = child->next_sibling) {
+        child->parent = NULL;
+    }
+    free(window);
+}
+
+static void render_layer(Layer *layer, GContext *ctx, GRect clip, GPoint origin) {
+    if (layer->hidden) {
+        return;
+    }
+    origin.x += layer->frame.origin.x;
+    origin.y += layer->frame.origin.y;
+    clip = grect_intersect(clip, GRect(origin.x, origin.y, layer->frame.size.w, layer->frame.size.h));
+    if (layer->update_proc != NULL) {
+        ctx->clip = clip;
+        ctx->origin = GPoint(origin.x + layer->bounds.origin.x, origin.y + layer->bounds.origin.y);
+        layer->update_proc(layer, ctx);
+    }
+    for (Layer *child = layer->first_child; child != NULL; child = child->next_sibling) {
+        render_layer(child, ctx, clip, GPoint(origin.x + layer->bounds.origin.x,
+                                              origin.y + layer->bounds.origin.y));
+    }
+}
+
+uint32_t stub_render(void) {
+    Window *window = window_stack_get_top_window();
+    if ((window == NULL) || !window->layer.dirty) {
+        return 0;
+    }
+    GContext ctx = { .fill_color = GColorBlack, .text_color = GColorBlack };
+
+    window->layer.dirty = false;
+    memset(touched, 0, sizeof(touched));
+    frame_pixels = 0;
+    if (!gcolor_equal(window->background_color, GColorClear)) {
+        ctx.clip = GRect(0, 0, STUB_SCREEN_WIDTH, STUB_SCREEN_HEIGHT);
+        touch(&ctx, ctx.clip);
+    }
+    render_layer(&window->layer, &ctx, GRect(0, 0, STUB_SCREEN_WIDTH, STUB_SCREEN_HEIGHT), GPoint(0, 0));
+    stub_counters.frames++;
+    stub_counters.pixels += frame_pixels;
+    stub_counters.last_frame_pixels = frame_pixels;
+    return frame_pixels;
+}
+
+static void button(ButtonId button_id, bool long_press) {
+    Window *window = window_stack_get_top_window();
+    if (window == NULL) {
+        return;
+    }
+    ClickHandler handler = long_press ? window->long_click[button_id] : window->single_click[button_id];
+    stub_counters.wakeups++;
+    if (handler != NULL) {
+        handler(NULL, window->click_config_context);
+    } else if (button_id == BUTTON_ID_BACK) {
+        window_stack_pop(true);
+    }
+    stub_render();
+}
+
+void stub_click(ButtonId button_id) {
+    button(button_id, false);
+}
+
+void stub_long_click(ButtonId button_id) {
+    button(button_id, true);
+}
+
+// Timers, and the link's deliveries and ACKs, in one queue ordered by due time
+
+typedef enum {
+    EVENT_TIMER,
+    EVENT_OUTBOX_DONE,
+    EVENT_INBOX
+} EventKind;
+
+struct AppTimer {
+    EventKind    kind;
+    uint64_t     due_ms;
+    uint32_t     sequence;              // keeps events due together in order
+    AppTimerCallback callback;
+    void        *data;
+    AppMessageResult result;            // EVENT_OUTBOX_DONE
+    uint8_t     *message;               // EVENT_INBOX
+    uint16_t     size;
+    struct AppTimer *next;
+};
+
+static AppTimer *events = NULL;
+static uint32_t  event_sequence = 0;
+
+static void event_queue(AppTimer *event, uint64_t due_ms) {
+    AppTimer **link = &events;
+    event->due_ms = due_ms;
+    event->sequence = event_sequence++;
+    while ((*link != NULL) && ((*link)->due_ms <= due_ms)) {
+        link = &(*link)->next;
+    }
+    event->next = *link;
+    *link = event;
+}
+
+static bool event_unqueue(AppTimer *event) {
+    for (AppTimer **link = &events; *link != NULL; link = &(*link)->next) {
+        if (*link == event) {
+            *link = event->next;
+            return true;
+        }
+    }
+    return false;
+}
+
+static AppTimer *event_create(EventKind kind) {
+    AppTimer *event = __real_malloc(sizeof(AppTimer));
+    memset(event, 0, sizeof(*event));
+    event->kind = kind;
+    return event;
+}
+
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data) {
+    AppTimer *timer = event_create(EVENT_TIMER);
+    timer->callback = callback;
+    timer->data = callback_data;
+    event_queue(timer, now_ms + timeout_ms);
+    return timer;
+}
+
+bool app_timer_reschedule(AppTimer *timer_handle, uint32_t new_timeout_ms) {
+    if (!event_unqueue(timer_handle)) {
+        return false;
+    }
+    event_queue(timer_handle, now_ms + new_timeout_ms);
+    return true;
+}
+
+void app_timer_cancel(AppTimer *timer_handle) {
+    if ((timer_handle != NULL) && event_unqueue(timer_handle)) {
+        __real_free(timer_handle);
+    }
+}
+
+static TickHandler tick_handler = NULL;
+static TimeUnits   tick_units = 0;
+
+void tick_timer_service_subscribe(TimeUnits tick_units_, TickHandler handler) {
+    tick_units = tick_units_;
+    tick_handler = handler;
+}
+
+void tick_timer_service_unsubscribe(void) {
+    tick_handler = NULL;
+}
+
+// Ticks come each minute, or only as the watch's hour changes when that's all that was asked for
+static uint64_t next_tick_ms(void) {
+    uint64_t next = ((now_ms / 60000) + 1) * 60000;
+    if (!(tick_units & (SECOND_UNIT | MINUTE_UNIT))) {
+        while (((int64_t)(next / 1000) + utc_offset) % 3600 != 0) {
+            next += 60000;
+        }
+    }
+    return next;
+}
+
+static void deliver_tick(void) {
+    struct tm tick_time;
+    watch_localtime(stub_now(), &tick_time);
+    stub_counters.ticks++;
+    stub_counters.wakeups++;
+    tick_handler(&tick_time, (tick_time.tm_min == 0) ? (MINUTE_UNIT | HOUR_UNIT) : MINUTE_UNIT);
+}
+
+// Battery and connection
+
+static BatteryChargeState  battery = { 80, false, false };
+static BatteryStateHandler battery_handler = NULL;
+static bool                connected = true;
+static ConnectionHandlers  connection_handlers;
+
+BatteryChargeState battery_state_service_peek(void) {
+    return battery;
+}
+
+void battery_state_service_subscribe(BatteryStateHandler handler) {
+    battery_handler = handler;
+}
+
+void battery_state_service_unsubscribe(void) {
+    battery_handler = NULL;
+}
+
+void stub_set_battery(uint8_t charge_percent, bool is_charging) {
+    battery.charge_percent = charge_percent;
+    battery.is_charging = is_charging;
+    battery.is_plugged = is_charging;
+    if (battery_handler != NULL) {
+        stub_counters.wakeups++;
+        battery_handler(battery);
+    }
+}
+
+bool connection_service_peek_pebble_app_connection(void) {
+    return connected;
+}
+
+void connection_service_subscribe(ConnectionHandlers conn_handlers) {
+    connection_handlers = conn_handlers;
+}
+
+void connection_service_unsubscribe(void) {
+    memset(&connection_handlers, 0, sizeof(connection_handlers));
+}
+
+void stub_set_connected(bool is_connected) {
+    connected = is_connected;
+    if (connection_handlers.pebble_app_connection_handler != NULL) {
+        stub_counters.wakeups++;
+        connection_handlers.pebble_app_connection_handler(connected);
+    }
+}
+
+// Dictionaries
+
+#define TUPLE_HEADER_LEN    7
+
+DictionaryResult dict_write_begin(DictionaryIterator *iter, uint8_t * const buffer, const uint16_t size) {
+    if ((iter == NULL) || (buffer == NULL) || (size < 1)) {
+        return DICT_INVALID_ARGS;
+    }
+    iter->dictionary = buffer;
+    iter->end = buffer + size;
+    iter->cursor = buffer + 1;
+    buffer[0] = 0;
+    return DICT_OK;
+}
+
+static DictionaryResult dict_write(DictionaryIterator *iter, uint32_t key, TupleType type,
+                                   const void *value, uint16_t length) {
+    if ((iter == NULL) || (iter->cursor == NULL)) {
+        return DICT_INVALID_ARGS;
+    }
+    if (iter->cursor + TUPLE_HEADER_LEN + length > iter->end) {
+        return DICT_NOT_ENOUGH_STORAGE;
+    }
+    Tuple *tuple = (Tuple *)iter->cursor;
+    tuple->key = key;
+    tuple->type = type;
+    tuple->length = length;
+    memcpy(tuple->value->data, value, length);
+    iter->cursor += TUPLE_HEADER_LEN + length;
+    iter->dictionary[0]++;
+    return DICT_OK;
+}
+
+DictionaryResult dict_write_data(DictionaryIterator *iter, const uint32_t key, const uint8_t * const data,
+                                 const uint16_t size) {
+    return dict_write(iter, key, TUPLE_BYTE_ARRAY, data, size);
+}
+
+DictionaryResult dict_write_cstring(DictionaryIterator *iter, const uint32_t key, const char * const cstring) {
+    return dict_write(iter, key, TUPLE_CSTRING, cstring, strlen(cstring) + 1);
+}
+
+DictionaryResult dict_write_int(DictionaryIterator *iter, const uint32_t key, const void *integer,
+                                const uint8_t width_bytes, const bool is_signed) {
+    return dict_write(iter, key, is_signed ? TUPLE_INT : TUPLE_UINT, integer, width_bytes);
+}
+
+DictionaryResult dict_write_uint8(DictionaryIterator *iter, const uint32_t key, const uint8_t value) {
+    return dict_write_int(iter, key, &value, 1, false);
+}
+
+DictionaryResult dict_write_uint16(DictionaryIterator *iter, const uint32_t key, const uint16_t value) {
+    return dict_write_int(iter, key, &value, 2, false);
+}
+
+DictionaryResult dict_write_uint32(DictionaryIterator *iter, const uint32_t key, const uint32_t value) {
+    return dict_write_int(iter, key, &value, 4, false);
+}
+
+DictionaryResult dict_write_int8(DictionaryIterator *iter, const uint32_t key, const int8_t value) {
+    return dict_write_int(iter, key, &value, 1, true);
+}
+
+DictionaryResult dict_write_int16(DictionaryIterator *iter, const uint32_t key, const int16_t value) {
+    return dict_write_int(iter, key, &value, 2, true);
+}
+
+DictionaryResult dict_write_int32(DictionaryIterator *iter, const uint32_t key, const int32_t value) {
+    return dict_write_int(iter, key, &value, 4, true);
+}
+
+DictionaryResult dict_write_tuplet(DictionaryIterator *iter, const Tuplet * const tuplet) {
+    switch (tuplet->type) {
+        case TUPLE_BYTE_ARRAY:
+            return dict_write_data(iter, tuplet->key, tuplet->bytes.data, tuplet->bytes.length);
+        case TUPLE_CSTRING:
+            return dict_write(iter, tuplet->key, TUPLE_CSTRING, tuplet->cstring.data, tuplet->cstring.length);
+        default:
+            return dict_write_int(iter, tuplet->key, &tuplet->integer.storage, tuplet->integer.width,
+                                  tuplet->type == TUPLE_INT);
+    }
+}
+
+uint32_t dict_write_end(DictionaryIterator *iter) {
+    if ((iter == NULL) || (iter->cursor == NULL)) {
+        return 0;
+    }
+    iter->end = iter->cursor;
+    return (uint32_t)(iter->cursor - iter->dictionary);
+}
+
+Tuple *dict_read_begin_from_buffer(DictionaryIterator *iter, const uint8_t * const buffer, const uint16_t size) {
+    iter->dictionary = (uint8_t *)buffer;
+    iter->end = buffer + size;
+    return dict_read_first(iter);
+}
+
+Tuple *dict_read_first(DictionaryIterator *iter) {
+    iter->cursor = iter->dictionary + 1;
+    return dict_read_next(iter);
+}
+
+Tuple *dict_read_next(DictionaryIterator *iter) {
+    if (iter->cursor + TUPLE_HEADER_LEN > iter->end) {
+        return NULL;
+    }
+    Tuple *tuple = (Tuple *)iter->cursor;
+    if (iter->cursor + TUPLE_HEADER_LEN + tuple->length > iter->end) {
+        return NULL;
+    }
+    iter->cursor += TUPLE_HEADER_LEN + tuple->length;
+    return tuple;
+}
+
+Tuple *dict_find(const DictionaryIterator *iter, const uint32_t key) {
+    DictionaryIterator copy = *iter;
+    for (Tuple *tuple = dict_read_first(&copy); tuple != NULL; tuple = dict_read_next(&copy)) {
+        if (tuple->key == key) {
+            return tuple;
+        }
+    }
+    return NULL;
+}
+
+// AppMessage. One message is in the outbox at a time; the phone sees it when it's sent and
+// the ACK (or failure) comes back a link delay later.
+
+#ifdef PBL_PLATFORM_APLITE
+#define STUB_INBOX_MAX      2026
+#define STUB_OUTBOX_MAX     656
+#else
+#define STUB_INBOX_MAX      8200
+#define STUB_OUTBOX_MAX     8200
+#endif
+
+typedef enum {
+    OUTBOX_CLOSED,
+    OUTBOX_IDLE,
+    OUTBOX_WRITING,
+    OUTBOX_SENDING
+} OutboxState;
+
+static OutboxState             outbox_state = OUTBOX_CLOSED;
+static uint8_t                 outbox[STUB_OUTBOX_MAX];
+static DictionaryIterator      outbox_iter;
+static uint32_t                inbox_size = 0;
+static uint32_t                link_delay_ms = 100;
+static AppMessageResult        fail_next = APP_MSG_OK;
+static StubPhoneHandler        phone = NULL;
+static AppMessageInboxReceived inbox_received = NULL;
+static AppMessageInboxDropped  inbox_dropped = NULL;
+static AppMessageOutboxSent    outbox_sent = NULL;
+static AppMessageOutboxFailed  outbox_failed = NULL;
+
+AppMessageResult app_message_open(const uint32_t size_inbound, const uint32_t size_outbound) {
+    inbox_size = (size_inbound < STUB_INBOX_MAX) ? size_inbound : STUB_INBOX_MAX;
+    outbox_state = OUTBOX_IDLE;
+    return APP_MSG_OK;
+}
+
+uint32_t app_message_inbox_size_maximum(void) {
+    return STUB_INBOX_MAX;
+}
+
+uint32_t app_message_outbox_size_maximum(void) {
+    return STUB_OUTBOX_MAX;
+}
+
+AppMessageInboxReceived app_message_register_inbox_received(AppMessageInboxReceived received_callback) {
+    AppMessageInboxReceived old = inbox_received;
+    inbox_received = received_callback;
+    return old;
+}
+
+AppMessageInboxDropped app_message_register_inbox_dropped(AppMessageInboxDropped dropped_callback) {
+    AppMessageInboxDropped old = inbox_dropped;
+    inbox_dropped = dropped_callback;
+    return old;
+}
+
+AppMessageOutboxSent app_message_register_outbox_sent(AppMessageOutboxSent sent_callback) {
+    AppMessageOutboxSent old = outbox_sent;
+    outbox_sent = sent_callback;
+    return old;
+}
+
+AppMessageOutboxFailed app_message_register_outbox_failed(AppMessageOutboxFailed failed_callback) {
+    AppMessageOutboxFailed old = outbox_failed;
+    outbox_failed = failed_callback;
+    return old;
+}
+
+void app_message_deregister_callbacks(void) {
+    inbox_received = NULL;
+    inbox_dropped = NULL;
+    outbox_sent = NULL;
+    outbox_failed = NULL;
+}
+
+AppMessageResult app_message_outbox_begin(DictionaryIterator **iterator) {
+    if (outbox_state != OUTBOX_IDLE) {
+        *iterator = NULL;
+        stub_counters.outbox_busy++;
+        return (outbox_state == OUTBOX_CLOSED) ? APP_MSG_CLOSED : APP_MSG_BUSY;
+    }
+    outbox_state = OUTBOX_WRITING;
+    dict_write_begin(&outbox_iter, outbox, sizeof(outbox));
+    *iterator = &outbox_iter;
+    return APP_MSG_OK;
+}
+
+AppMessageResult app_message_outbox_send(void) {
+    if (outbox_state != OUTBOX_WRITING) {
+        return APP_MSG_INVALID_ARGS;
+    }
+    AppTimer *done = event_create(EVENT_OUTBOX_DONE);
+    uint16_t size = (uint16_t)(outbox_iter.cursor - outbox);
+
+    outbox_state = OUTBOX_SENDING;
+    outbox_iter.end = outbox_iter.cursor;
+    stub_counters.messages_out++;
+    stub_counters.bytes_out += size;
+    done->result = connected ? fail_next : APP_MSG_NOT_CONNECTED;
+    fail_next = APP_MSG_OK;
+    if ((done->result == APP_MSG_OK) && (phone != NULL)) {
+        phone(outbox, size);
+    }
+    event_queue(done, now_ms + 2 * link_delay_ms);
+    return APP_MSG_OK;
+}
+
+bool stub_outbox_idle(void) {
+    return outbox_state == OUTBOX_IDLE;
+}
+
+void stub_set_phone(StubPhoneHandler handler) {
+    phone = handler;
+}
+
+void stub_set_link_delay(uint32_t ms) {
+    link_delay_ms = ms;
+}
+
+void stub_fail_next_send(AppMessageResult reason) {
+    fail_next = reason;
+}
+
+void stub_send_to_watch(const uint8_t *data, uint16_t size) {
+    AppTimer *delivery = event_create(EVENT_INBOX);
+    delivery->message = __real_malloc(size);
+    memcpy(delivery->message, data, size);
+    delivery->size = size;
+    event_queue(delivery, now_ms + link_delay_ms);
+}
+
+static void deliver_outbox_done(AppTimer *event) {
+    outbox_state = OUTBOX_IDLE;
+    if (event->result == APP_MSG_OK) {
+        if (outbox_sent != NULL) {
+            outbox_sent(&outbox_iter, NULL);
+        }
+    } else if (outbox_failed != NULL) {
+        outbox_failed(&outbox_iter, event->result, NULL);
+    }
+}
+
+static void deliver_inbox(AppTimer *event) {
+    DictionaryIterator iter;
+
+    stub_counters.messages_in++;
+    stub_counters.bytes_in += event->size;
+    if (!connected || (outbox_state == OUTBOX_CLOSED)) {
+        return;
+    }
+    if (event->size > inbox_size) {
+        if (inbox_dropped != NULL) {
+            inbox_dropped(APP_MSG_BUFFER_OVERFLOW, NULL);
+        }
+        return;
+    }
+    if (inbox_received != NULL) {
+        dict_read_begin_from_buffer(&iter, event->message, event->size);
+        inbox_received(&iter, NULL);
+    }
+}
+
+// The run loop
+
+void stub_advance(uint64_t ms) {
+    uint64_t target = now_ms + ms;
+
+    for (;;) {
+        // A tick goes before a timer due at the same moment, rather than being skipped by it
+        uint64_t next_tick = next_tick_ms();
+        bool tick = (tick_handler != NULL) && (next_tick <= target) &&
+                    ((events == NULL) || (next_tick <= events->due_ms));
+
+        if (tick) {
+            now_ms = next_tick;
+            deliver_tick();
+        } else if ((events != NULL) && (events->due_ms <= target)) {
+            AppTimer *event = events;
+            events = event->next;
+            now_ms = (event->due_ms > now_ms) ? event->due_ms : now_ms;
+            stub_counters.wakeups++;
+            switch (event->kind) {
+                case EVENT_TIMER:
+                    stub_counters.timers_fired++;
+                    event->callback(event->data);
+                    break;
+                case EVENT_OUTBOX_DONE:
+                    deliver_outbox_done(event);
+                    break;
+                case EVENT_INBOX:
+                    deliver_inbox(event);
+                    __real_free(event->message);
+                    break;
+            }
+            __real_free(event);
+        } else {
+            break;
+        }
+        stub_render();
+    }
+    now_ms = target;
+}
+
+// Persistent storage
+
+#define STUB_PERSIST_KEYS   64
+
+static struct {
+    bool         used;
+    uint32_t     key;
+    uint16_t     size;
+    uint8_t      data[PERSIST_DATA_MAX_LENGTH];
+} persist[STUB_PERSIST_KEYS];
+
+static int persist_find(uint32_t key, bool create) {
+    int free_slot = -1;
+    for (int i = 0; i < STUB_PERSIST_KEYS; i++) {
+        if (persist[i].used && (persist[i].key == key)) {
+            return i;
+        }
+        if (!persist[i].used && (free_slot < 0)) {
+            free_slot = i;
+        }
+    }
+    if (create && (free_slot >= 0)) {
+        persist[free_slot].used = true;
+        persist[free_slot].key = key;
+        return free_slot;
+    }
+    return -1;
+}
+
+bool persist_exists(const uint32_t key) {
+    return persist_find(key, false) >= 0;
+}
+
+int32_t persist_read_int(const uint32_t key) {
+    int32_t value = 0;
+    int slot = persist_find(key, false);
+    if ((slot >= 0) && (persist[slot].size == sizeof(value))) {
+        memcpy(&value, persist[slot].data, sizeof(value));
+    }
+    return value;
+}
+
+int persist_read_data(const uint32_t key, void *buffer, const size_t buffer_size) {
+    int slot = persist_find(key, false);
+    if (slot < 0) {
+        return -1;
+    }
+    size_t size = (persist[slot].size < buffer_size) ? persist[slot].size : buffer_size;
+    memcpy(buffer, persist[slot].data, size);
+    return (int)size;
+}
+
+int persist_write_data(const uint32_t key, const void *data, const size_t size) {
+    int slot = persist_find(key, true);
+    if ((slot < 0) || (size > PERSIST_DATA_MAX_LENGTH)) {
+        return -1;
+    }
+    memcpy(persist[slot].data, data, size);
+    persist[slot].size = (uint16_t)size;
+    stub_counters.persist_writes++;
+    stub_counters.persist_bytes += size;
+    return (int)size;
+}
+
+int persist_write_int(const uint32_t key, const int32_t value) {
+    return persist_write_data(key, &value, sizeof(value));
+}
+
+int persist_delete(const uint32_t key) {
+    int slot = persist_find(key, false);
+    if (slot >= 0) {
+        persist[slot].used = false;
+    }
+    return 0;
+}
+
+void stub_clear_persist(void) {
+    memset(persist, 0, sizeof(persist));
+}
+
+// Background workers
+
+static bool worker_ours = false;
+static bool worker_other = false;
+
+bool app_worker_is_running(void) {
+    return worker_ours;
+}
+
+AppWorkerResult app_worker_launch(void) {
+    if (worker_ours) {
+        return APP_WORKER_RESULT_ALREADY_RUNNING;
+    }
+    stub_counters.worker_launches++;
+    if (worker_other) {
+        stub_counters.worker_prompts++;
+        worker_other = false;
+    }
+    worker_ours = true;
+    return APP_WORKER_RESULT_SUCCESS;
+}
+
+AppWorkerResult app_worker_kill(void) {
+    if (!worker_ours) {
+        return APP_WORKER_RESULT_NOT_RUNNING;
+    }
+    worker_ours = false;
+    return APP_WORKER_RESULT_SUCCESS;
+}
+
+void stub_set_worker(bool ours_running, bool other_running) {
+    worker_ours = ours_running;
+    worker_other = other_running;
+}
+
+bool stub_worker_running(void) {
+    return worker_ours;
+}
+
+// Event loops
+
+void app_event_loop(void) {
+}
+
+void worker_event_loop(void) {
+}
+
+void stub_reset(void) {
+    while (events != NULL) {
+        AppTimer *event = events;
+        events = event->next;
+        if (event->kind == EVENT_INBOX) {
+            __real_free(event->message);
+        }
+        __real_free(event);
+    }
+    window_stack_count = 0;
+    tick_handler = NULL;
+    battery_handler = NULL;
+    memset(&connection_handlers, 0, sizeof(connection_handlers));
+    app_message_deregister_callbacks();
+    outbox_state = OUTBOX_CLOSED;
+    fail_next = APP_MSG_OK;
+    phone = NULL;
+    malloc_fail_at = 0;
+}
@@ -0,0 +1,95 @@
+//
+//  stub.h
+//  Drives the host SDK in stub.c: a mock clock that fires ticks and timers, a window stack
+//  that renders into a counting framebuffer, an AppMessage link to a scripted phone, and
+//  counters for the SDK calls the app makes.
+//
+//  Sizes are host sizes (64-bit pointers), so heap figures compare builds with each other
+//  rather than predicting the watch's numbers.
+//
+
+#ifndef PebbleWorldTime_host_stub_h
+#define PebbleWorldTime_host_stub_h
+
+#include "pebble.h"
+
+#define STUB_SCREEN_WIDTH   144
+#define STUB_SCREEN_HEIGHT  168
+
+// Everything the app did through the SDK since the last stub_reset_counters()
+typedef struct {
+    uint32_t     time_calls;
+    uint32_t     localtime_calls;
+    uint32_t     strftime_calls;
+    uint32_t     dirty_marks;           // layer_mark_dirty()
+    uint32_t     allocs;                // malloc() by the app, including SDK objects it creates
+    uint32_t     frees;
+    uint32_t     frames;                // renders of a dirty window
+    uint32_t     draw_calls;
+    uint64_t     pixels;                // distinct pixels draw calls touched, summed over frames
+    uint32_t     last_frame_pixels;
+    uint32_t     wakeups;               // ticks, timers, messages and clicks delivered
+    uint32_t     ticks;
+    uint32_t     timers_fired;
+    uint32_t     messages_out;
+    uint32_t     bytes_out;
+    uint32_t     outbox_busy;           // app_message_outbox_begin() refused
+    uint32_t     messages_in;
+    uint32_t     bytes_in;
+    uint32_t     persist_writes;
+    uint32_t     persist_bytes;
+    uint32_t     worker_launches;
+    uint32_t     worker_prompts;        // launches that displaced another app's worker
+} StubCounters;
+
+extern StubCounters stub_counters;
+
+void stub_reset_counters(void);
+
+// Brings the SDK back to its state before the app started: empty stack, no timers, no
+// subscriptions, an idle link. Persistent storage and the clock are kept.
+void stub_reset(void);
+void stub_clear_persist(void);
+
+// Heap. Allocations are counted while the app runs, including the SDK objects it creates.
+size_t stub_heap_peak(void);
+void stub_reset_heap_peak(void);
+void stub_fail_malloc(int nth);         // the nth malloc() from now returns NULL, 0 to stop
+
+// Clock. time() is UTC; localtime() applies the watch's own UTC offset, as on the watch.
+void stub_set_time(time_t utc, uint16_t ms);
+void stub_set_utc_offset(int32_t secs);
+void stub_set_24h_style(bool is_24h);
+time_t stub_now(void);
+uint64_t stub_now_ms(void);
+
+// Runs everything due in the next ms milliseconds in order: ticks, app timers, message
+// deliveries and their ACKs. The top window is rendered after each one.
+void stub_advance(uint64_t ms);
+
+// Draws the top window if anything marked it dirty, over its background colour unless that's
+// GColorClear. Returns the pixels the frame touched.
+uint32_t stub_render(void);
+
+// Buttons go to the top window's click config, BACK pops by default
+void stub_click(ButtonId button);
+void stub_long_click(ButtonId button);
+
+// The phone. The handler sees each message the watch sends, as it's sent; replies go back
+// with stub_send_to_watch().
+typedef void (*StubPhoneHandler)(const uint8_t *data, uint16_t size);
+
+void stub_set_phone(StubPhoneHandler handler);
+void stub_set_link_delay(uint32_t ms);  // each way, including the ACK
+void stub_fail_next_send(AppMessageResult reason);
+void stub_send_to_watch(const uint8_t *data, uint16_t size);
+bool stub_outbox_idle(void);
+
+void stub_set_connected(bool connected);
+void stub_set_battery(uint8_t charge_percent, bool is_charging);
+
+// Background workers: this app's, or some other app's that launching ours would displace
+void stub_set_worker(bool ours_running, bool other_running);
+bool stub_worker_running(void);
+
+#endif
@@ -0,0 +1,69 @@
+//
+//  sun_test.c
+//  Works out sunrise and sunset on the watch for places and dates across the year and checks
+//  them against the NOAA solar calculator, to within two minutes. Includes a sunset that
+//  falls after midnight, held at 24:00, and polar night and midnight sun. The stub's
+//  sin_lookup() and cos_lookup() are exact, so the error the firmware's table adds isn't
+//  covered.
+//
+
+#include "test_util.h"
+
+#define TOLERANCE_MINUTES   2
+
+// Times in minutes from local midnight, from the NOAA solar calculator's equations
+typedef struct {
+    const char  *what;
+    int          year;
+    int          yday;                  // 0 is January 1st
+    int16_t      latitude;              // hundredths of a degree
+    int16_t      longitude;
+    int32_t      offset;                // seconds east of UTC
+    int          rise;
+    int          set;
+} SunCase;
+
+static const SunCase cases[] = {
+    { "London, 13 Oct 2015",      2015, 285,  5151,    -13,      0,  380, 1032 },
+    { "London, 21 Jun 2015",      2015, 171,  5151,    -13,   3600,  283, 1282 },
+    { "New York, 1 Mar 2015",     2015,  59,  4071,  -7401, -18000,  390, 1067 },
+    { "New York, 4 Nov 2015",     2015, 307,  4071,  -7401, -18000,  390, 1009 },
+    { "New York, 10 Jul 2016",    2016, 191,  4071,  -7401, -14400,  334, 1228 },
+    { "Tokyo, 1 Feb 2016",        2016,  31,  3569,  13969,  32400,  402, 1028 },
+    { "Sydney, 21 Dec 2015",      2015, 354, -3387,  15121,  39600,  341, 1205 },
+    { "Quito, 1 Mar 2015",        2015,  59,   -18,  -7847, -18000,  383, 1110 },
+    { "Reykjavik, 25 Jun 2015",   2015, 175,  6415,  -2194,      0,  177, 1440 },
+    { "Tromso, 21 Dec 2015",      2015, 354,  6965,   1896,   3600, 1440, 1440 },
+    { "Tromso, 21 Jun 2015",      2015, 171,  6965,   1896,   7200,    0, 1440 },
+};
+
+int main(void) {
+    int worst = 0;
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        const SunCase *c = &cases[i];
+        WatchFace wf = {
+            .has_location   = true,
+            .latitude       = c->latitude,
+            .longitude      = c->longitude,
+            .gmt_sec_offset = c->offset,
+        };
+        struct tm local_time = { .tm_year = c->year - 1900, .tm_yday = c->yday, .tm_hour = 12 };
+
+        update_sun_times(&wf, &local_time);
+        int rise = wf.sunrise_hour * 60 + wf.sunrise_min;
+        int set  = wf.sunset_hour * 60 + wf.sunset_min;
+        int error = abs(rise - c->rise) > abs(set - c->set) ? abs(rise - c->rise) : abs(set - c->set);
+        if (error > worst) {
+            worst = error;
+        }
+        if (error > TOLERANCE_MINUTES) {
+            printf("FAIL %s: %02d:%02d to %02d:%02d, expected %02d:%02d to %02d:%02d\n", c->what,
+                   rise / 60, rise % 60, set / 60, set % 60,
+                   c->rise / 60, c->rise % 60, c->set / 60, c->set % 60);
+            failures++;
+        }
+    }
+    printf("sun times: worst error %d minutes\n", worst);
+    return test_result("sun");
+}
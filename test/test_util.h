@@ -0,0 +1,73 @@
+//
+//  test_util.h
+//  What every host test starts from: the app built in with its main() renamed so the test's
+//  own main() drives it, the stub SDK, the launch a user's press would do, messages from the
+//  phone, and the checks each test counts its failures through. Include it once, first; a test
+//  of the background worker defines TEST_WORKER before it to build the worker in instead.
+//
+
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+// The app's main() falls off the end, which is fine for main() but not once it's renamed
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wreturn-type"
+#ifdef TEST_WORKER
+#define main worldtimej_worker_main
+#include "../worker_src/worldtimej_worker.c"
+#else
+#define main worldtimej_main
+#include "../src/worldtimej.c"
+#endif
+#undef main
+#pragma GCC diagnostic pop
+
+#include "stub.h"
+
+static int failures = 0;
+
+static inline void expect(bool ok, const char *what) {
+    if (!ok) {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+// Prints the test's verdict; main() returns what this does
+static inline int test_result(const char *name) {
+    printf("%s: %s\n", failures ? "FAIL" : "PASS", name);
+    return failures ? 1 : 0;
+}
+
+#ifndef TEST_WORKER
+// Starts the app on a fresh SDK talking to the given phone, or none, with persistent storage
+// and the clock left as they are, and lets its first second run
+static inline void launch(StubPhoneHandler phone) {
+    stub_reset();
+    stub_reset_counters();
+    stub_set_phone(phone);
+    init();
+    stub_advance(1000);
+}
+#endif
+
+// The phone sends one tuple, delivered over the link delay
+static inline void send_data(uint32_t key, const uint8_t *data, uint16_t size) {
+    DictionaryIterator iter;
+    uint8_t buffer[64];
+
+    dict_write_begin(&iter, buffer, sizeof(buffer));
+    dict_write_data(&iter, key, data, size);
+    stub_send_to_watch(buffer, dict_write_end(&iter));
+}
+
+static inline void send_uint8(uint32_t key, uint8_t value) {
+    DictionaryIterator iter;
+    uint8_t buffer[32];
+
+    dict_write_begin(&iter, buffer, sizeof(buffer));
+    dict_write_uint8(&iter, key, value);
+    stub_send_to_watch(buffer, dict_write_end(&iter));
+}
+
+#endif
@@ -0,0 +1,55 @@
+//
+//  worker_test.c
+//  Opens and closes the app the way a user would and checks when the background worker is
+//  started on exit: only once it's turned on, and never over another app's worker the user
+//  chose since.
+//
+
+#include "test_util.h"
+
+// Opens the app, lets the user do something, closes it, and checks what the exit did
+static void session(const char *what, void (*during)(void), bool expect_launch) {
+    launch(NULL);
+    if (during != NULL) {
+        during();
+    }
+    deinit();
+    if ((stub_counters.worker_launches != 0) != expect_launch) {
+        printf("FAIL %s: worker %s\n", what, expect_launch ? "not started" : "started");
+        failures++;
+    }
+    if (stub_counters.worker_prompts != 0) {
+        printf("FAIL %s: displaced another app's worker\n", what);
+        failures++;
+    }
+}
+
+static void turn_on(void) {
+    send_uint8(PBCOMM_WORKER_KEY, true);
+    stub_advance(1000);
+}
+
+static void turn_off(void) {
+    send_uint8(PBCOMM_WORKER_KEY, false);
+    stub_advance(1000);
+}
+
+int main(void) {
+    stub_clear_persist();
+    stub_set_worker(false, false);
+    session("never turned on", NULL, false);
+    session("turned on", turn_on, true);
+    session("running since", NULL, true);
+
+    // The user picks another app's worker; ours stays off from then on
+    stub_set_worker(false, true);
+    session("another app's worker chosen", NULL, false);
+    session("another app's worker still chosen", NULL, false);
+
+    // Turned off, it isn't started even though it was running
+    stub_set_worker(true, false);
+    session("turned off", turn_off, false);
+    session("off since", NULL, false);
+
+    return test_result("worker");
+}
@@ -0,0 +1,65 @@
+//
+//  worker_zones_test.c
+//  Runs the background worker over a stored zone with a DST transition on the half hour: it
+//  wakes hourly until the transition is less than an hour off, switches the zone's offset on
+//  the minute it's due, and goes back to hourly once nothing else is.
+//
+
+#define TEST_WORKER
+#include "test_util.h"
+
+#define START_TIME      1446336000      // 2015-11-01 00:00 UTC
+#define TRANSITION_AT   (START_TIME + 5 * 3600 + 30 * 60)
+#define OLD_OFFSET      (-25200)
+#define NEW_OFFSET      (-28800)
+
+static int32_t stored_offset(void) {
+    PersistedZone pz;
+    persist_read_data(PERSIST_ZONE_KEY, &pz, sizeof(pz));
+    return pz.gmt_sec_offset;
+}
+
+int main(void) {
+    PersistedZone pz = {
+        .gmt_sec_offset     = OLD_OFFSET,
+        .last_weather_update = START_TIME,
+        .transition_count   = 1,
+        .transitions        = {
+            [TRANSITION_TIME]   = TRANSITION_AT & 0xFF,
+            [TRANSITION_TIME+1] = (TRANSITION_AT >> 8) & 0xFF,
+            [TRANSITION_TIME+2] = (TRANSITION_AT >> 16) & 0xFF,
+            [TRANSITION_TIME+3] = (TRANSITION_AT >> 24) & 0xFF,
+            [TRANSITION_OFFSET] = (uint8_t)(NEW_OFFSET / (15 * 60)),
+        },
+        .days_rolled        = MAX_WEATHER_DAYS,
+    };
+
+    stub_clear_persist();
+    persist_write_int(PERSIST_VERSION_KEY, PERSIST_VERSION);
+    persist_write_int(PERSIST_ZONE_COUNT_KEY, 1);
+    persist_write_data(PERSIST_ZONE_KEY, &pz, sizeof(pz));
+    stub_set_time(START_TIME, 0);
+    stub_set_utc_offset(OLD_OFFSET);
+    worker_init();
+    stub_reset_counters();
+
+    // Nothing due within the hour: one tick an hour
+    stub_advance(5 * 3600 * 1000);
+    expect(stub_counters.ticks == 5, "hourly ticks while the transition is hours off");
+    expect(stored_offset() == OLD_OFFSET, "offset kept before the transition");
+
+    // Under an hour off, minute ticks catch it on the minute
+    stub_advance(30 * 60 * 1000 - 1000);
+    expect(stored_offset() == OLD_OFFSET, "offset kept until the transition's minute");
+    stub_advance(1000);
+    expect(stored_offset() == NEW_OFFSET, "offset switched on the transition's minute");
+    expect(stub_counters.ticks == 5 + 30, "minute ticks only in the hour before the transition");
+
+    // With nothing left to do it goes back to hourly
+    stub_reset_counters();
+    stub_advance(24 * 3600 * 1000);
+    expect(stub_counters.ticks == 24, "hourly ticks once nothing is due");
+
+    worker_deinit();
+    return test_result("worker_zones");
+}
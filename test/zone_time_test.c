@@ -0,0 +1,110 @@
+//
+//  zone_time_test.c
+//  Checks zone_time() against a full calendar conversion of each zone's time: across ticks
+//  and midnights, when a zone's offset changes, and when the watch's own offset changes,
+//  with or without the phone catching up. Also counts the conversions a day of ticks costs.
+//
+
+#include "test_util.h"
+
+#define TEST_START      1425168000      // 2015-03-01 00:00 UTC
+
+static const int32_t test_offsets[MAX_WATCH_FACES] = {
+    -28800, 0, 32400, -43200, 50400, 20700, 49500, -12600
+};
+
+static int32_t watch_offset;
+// What the zone should show: the watch's time moved by the zone's difference from watch 0
+static void expect_zones(const char *when) {
+    for (int i = 0; i < MAX_WATCH_FACES; i++) {
+        struct tm expected;
+        time_t secs = stub_now() + watch_offset - watchfaces[0].gmt_sec_offset + watchfaces[i].gmt_sec_offset;
+        gmtime_r(&secs, &expected);
+        struct tm *actual = zone_time(&watchfaces[i], watchfaces[0].gmt_sec_offset);
+        if ((actual->tm_hour != expected.tm_hour) || (actual->tm_min != expected.tm_min) ||
+            (actual->tm_sec != expected.tm_sec) || (actual->tm_mday != expected.tm_mday) ||
+            (actual->tm_mon != expected.tm_mon) || (actual->tm_year != expected.tm_year) ||
+            (actual->tm_wday != expected.tm_wday) || (actual->tm_yday != expected.tm_yday)) {
+            if (failures++ < 10) {
+                printf("FAIL %s, zone %d at %ld: %04d-%02d-%02d %02d:%02d:%02d, expected %04d-%02d-%02d %02d:%02d:%02d\n",
+                       when, i, (long)stub_now(),
+                       actual->tm_year + 1900, actual->tm_mon + 1, actual->tm_mday,
+                       actual->tm_hour, actual->tm_min, actual->tm_sec,
+                       expected.tm_year + 1900, expected.tm_mon + 1, expected.tm_mday,
+                       expected.tm_hour, expected.tm_min, expected.tm_sec);
+            }
+        }
+    }
+}
+
+static void set_watch_offset(int32_t secs) {
+    watch_offset = secs;
+    stub_set_utc_offset(secs);
+}
+
+int main(void) {
+    stub_set_time(TEST_START, 0);
+    set_watch_offset(test_offsets[0]);
+    launch(NULL);
+    set_zone_count(MAX_WATCH_FACES);
+    for (int i = 0; i < MAX_WATCH_FACES; i++) {
+        set_gmt_offset(i, test_offsets[i]);
+    }
+    commit_zone_changes();
+
+    // Ten days of ticks, checked at each and at odd seconds between them
+    srand(1);
+    for (int minute = 0; minute < 10 * 1440; minute++) {
+        stub_advance(60000);
+        expect_zones("tick");
+        if (minute % 7 == 0) {
+            stub_advance(rand() % 59000);
+            expect_zones("between ticks");
+            stub_advance(60000 - (stub_now_ms() % 60000) - 1);
+        }
+    }
+
+    // A day of ticks with every zone on screen costs one conversion per zone, at its midnight
+    stub_advance(60000 - (stub_now_ms() % 60000));
+    stub_reset_counters();
+    for (int minute = 0; minute < 1440; minute++) {
+        stub_advance(60000);
+        for (int i = 0; i < MAX_WATCH_FACES; i++) {
+            update_time(&watchfaces[i], watchfaces[0].gmt_sec_offset);
+        }
+    }
+    printf("localtime calls over a day of ticks, %d zones: %d\n", MAX_WATCH_FACES,
+           (int)stub_counters.localtime_calls);
+    if (stub_counters.localtime_calls > MAX_WATCH_FACES) {
+        printf("FAIL more than one conversion per zone a day\n");
+        failures++;
+    }
+
+    // The watch falls back and the phone's transition table moves watch 0 with it
+    stub_advance(1800 * 1000 + 20 * 1000);
+    set_watch_offset(test_offsets[0] - 3600);
+    set_gmt_offset(0, test_offsets[0] - 3600);
+    expect_zones("fall back");
+    stub_advance(60000);
+    expect_zones("tick after fall back");
+
+    // The watch moves zone before the phone hears about it: watch 0 shows the watch's time
+    // from the next second, when the reference time is next converted
+    set_watch_offset(19800);
+    stub_advance(1000);
+    expect_zones("watch zone change");
+    stub_advance(90 * 1000);
+    expect_zones("tick after watch zone change");
+    set_gmt_offset(0, 19800);
+    expect_zones("phone catches up");
+
+    // Another zone springs forward across its midnight
+    stub_set_time(TEST_START + 40 * 86400 + 86400 - 32400 - 1800, 0);
+    expect_zones("before midnight");
+    set_gmt_offset(2, 32400 + 3600);
+    expect_zones("zone springs forward over midnight");
+    set_gmt_offset(2, 32400 - 3 * 3600);
+    expect_zones("zone falls back over midnight");
+
+    return test_result("zone_time");
+}
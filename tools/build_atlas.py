@@ -0,0 +1,161 @@
+#!/usr/bin/env python
+#
+# Packs the weather condition icons into one strip so the watch can load them as a single
+# resource and slice them with gbitmap_create_as_sub_bitmap().
+#
+# Writes resources/images/WeatherAtlas.png for colour platforms and WeatherAtlas~bw.png, a
+# 1-bit version, for aplite. Rerun it whenever an icon in resources/images changes.
+#
+# Pure python (zlib only) so it runs anywhere the SDK does.
+#
+
+import os
+import struct
+import sys
+import zlib
+
+ICON_SIZE = 36
+
+# Cell order in the strip. Must match weather_atlas_cell in src/worldtimej.c.
+# There is no sleet icon, so WEATHER_SLEET reuses the snow cell.
+ICONS = [
+    'Unknown.png',              # WEATHER_UNKNOWN
+    'ClearDay.png',             # WEATHER_CLEAR_DAY
+    'ClearNight.png',           # WEATHER_CLEAR_NIGHT
+    'Rain.png',                 # WEATHER_RAIN
+    'Snow.png',                 # WEATHER_SNOW, WEATHER_SLEET
+    'Wind.png',                 # WEATHER_WIND
+    'Fog.png',                  # WEATHER_FOG
+    'Cloudy.png',               # WEATHER_CLOUDY
+    'PartlyCloudyDay.png',      # WEATHER_PARTLY_CLOUDY_DAY
+    'PartlyCloudyNight.png',    # WEATHER_PARTLY_CLOUDY_NIGHT
+]
+
+CHANNELS = {0: 1, 2: 3, 4: 2, 6: 4}
+
+
+def read_chunks(data):
+    if data[:8] != b'\x89PNG\r\n\x1a\n':
+        raise ValueError('not a PNG')
+    pos = 8
+    while pos < len(data):
+        length, kind = struct.unpack('>I4s', data[pos:pos + 8])
+        yield kind, data[pos + 8:pos + 8 + length]
+        pos += 12 + length
+
+
+def unfilter(raw, width, height, bpp, stride):
+    rows = []
+    prev = bytearray(stride)
+    pos = 0
+    for _ in range(height):
+        kind = raw[pos]
+        line = bytearray(raw[pos + 1:pos + 1 + stride])
+        pos += 1 + stride
+        for i in range(stride):
+            a = line[i - bpp] if i >= bpp else 0
+            b = prev[i]
+            c = prev[i - bpp] if i >= bpp else 0
+            if kind == 1:
+                line[i] = (line[i] + a) & 0xff
+            elif kind == 2:
+                line[i] = (line[i] + b) & 0xff
+            elif kind == 3:
+                line[i] = (line[i] + ((a + b) >> 1)) & 0xff
+            elif kind == 4:
+                p = a + b - c
+                pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+                pred = a if (pa <= pb and pa <= pc) else (b if pb <= pc else c)
+                line[i] = (line[i] + pred) & 0xff
+        rows.append(line)
+        prev = line
+    return rows
+
+
+def load_rgba(path):
+    """Returns a list of rows of (r, g, b, a) tuples. Handles the non-interlaced greyscale and
+    RGBA PNGs found in resources/images."""
+    data = open(path, 'rb').read()
+    idat = b''
+    for kind, body in read_chunks(data):
+        if kind == b'IHDR':
+            width, height, depth, colour, _, _, interlace = struct.unpack('>IIBBBBB', body)
+        elif kind == b'IDAT':
+            idat += body
+    if interlace or colour not in CHANNELS or depth not in (1, 2, 4, 8):
+        raise ValueError('%s: unsupported PNG format' % path)
+    channels = CHANNELS[colour]
+    stride = (width * channels * depth + 7) // 8
+    bpp = max(1, channels * depth // 8)
+    rows = unfilter(zlib.decompress(idat), width, height, bpp, stride)
+    pixels = []
+    for line in rows:
+        if depth == 8:
+            samples = list(line)
+        else:
+            samples = []
+            scale = 255 // ((1 << depth) - 1)
+            for byte in line:
+                for shift in range(8 - depth, -1, -depth):
+                    samples.append(((byte >> shift) & ((1 << depth) - 1)) * scale)
+        row = []
+        for x in range(width):
+            s = samples[x * channels:(x + 1) * channels]
+            if colour == 0:
+                row.append((s[0], s[0], s[0], 255))
+            elif colour == 4:
+                row.append((s[0], s[0], s[0], s[1]))
+            elif colour == 2:
+                row.append((s[0], s[1], s[2], 255))
+            else:
+                row.append(tuple(s))
+        pixels.append(row)
+    return width, height, pixels
+
+
+def chunk(kind, body):
+    return (struct.pack('>I', len(body)) + kind + body +
+            struct.pack('>I', zlib.crc32(kind + body) & 0xffffffff))
+
+
+def write_png(path, width, height, depth, colour, lines):
+    raw = b''.join(b'\x00' + bytes(line) for line in lines)
+    with open(path, 'wb') as out:
+        out.write(b'\x89PNG\r\n\x1a\n')
+        out.write(chunk(b'IHDR', struct.pack('>IIBBBBB', width, height, depth, colour, 0, 0, 0)))
+        out.write(chunk(b'IDAT', zlib.compress(raw, 9)))
+        out.write(chunk(b'IEND', b''))
+
+
+def to_bw(pixel):
+    # Flatten onto white, the background GCompOpAssign draws the icons on, then threshold
+    r, g, b, a = pixel
+    lum = (r * 299 + g * 587 + b * 114) // 1000
+    return 1 if (lum * a + 255 * (255 - a)) // 255 >= 128 else 0
+
+
+def main(images):
+    strip = []
+    for name in ICONS:
+        width, height, pixels = load_rgba(os.path.join(images, name))
+        if (width, height) != (ICON_SIZE, ICON_SIZE):
+            sys.exit('%s: expected %dx%d, got %dx%d' % (name, ICON_SIZE, ICON_SIZE, width, height))
+        strip.extend(pixels)
+    height = len(strip)
+
+    write_png(os.path.join(images, 'WeatherAtlas.png'), ICON_SIZE, height, 8, 6,
+              [[c for p in row for c in p] for row in strip])
+
+    bw_lines = []
+    for row in strip:
+        line = bytearray((ICON_SIZE + 7) // 8)
+        for x, pixel in enumerate(row):
+            if to_bw(pixel):
+                line[x // 8] |= 0x80 >> (x % 8)
+        bw_lines.append(line)
+    write_png(os.path.join(images, 'WeatherAtlas~bw.png'), ICON_SIZE, height, 1, 0, bw_lines)
+
+
+if __name__ == '__main__':
+    here = os.path.dirname(os.path.abspath(__file__))
+    main(os.path.join(here, '..', 'resources', 'images'))
@@ -0,0 +1,139 @@
+#include <pebble_worker.h>
+#include "../src/PWTimePersist.h"
+
+// Keeps the zone state the app restores at launch current while the app is closed. Workers
+// can't use AppMessage, so this can't fetch anything; it does what the watch can on its own:
+// switches each zone to its new GMT offset when a DST transition passes, and drops forecast
+// days as each zone's date moves on, so a launch shows today's forecast first.
+
+#define SECONDS_PER_HOUR    3600
+#define SECONDS_PER_DAY     86400
+
+static time_t    next_check = 0;    // earliest time a stored zone needs changing
+static TimeUnits tick_units = 0;    // what the tick subscription is for, 0 before there is one
+
+/*
+ * Brings one stored zone up to date. Returns true if anything changed.
+ */
+static bool refresh_zone(PersistedZone *pz, time_t now) {
+    bool changed = false;
+
+    while ((pz->transition_count > 0) && (transition_time(pz->transitions) <= now)) {
+        pz->gmt_sec_offset = transition_offset(pz->transitions);
+        pz->transition_count--;
+        memmove(pz->transitions, &pz->transitions[TRANSITION_LEN],
+                pz->transition_count * TRANSITION_LEN);
+        changed = true;
+    }
+
+    // The forecast starts on the zone's date when it arrived. The current temperature is left
+    // as last reported, there's nothing better to show.
+    int32_t days = ((int32_t)(now + pz->gmt_sec_offset) / SECONDS_PER_DAY) -
+                   ((int32_t)(pz->last_weather_update + pz->gmt_sec_offset) / SECONDS_PER_DAY);
+    while ((pz->days_rolled < days) && (pz->days_rolled < MAX_WEATHER_DAYS)) {
+        for (int j = 0; j < MAX_WEATHER_DAYS - 1; j++) {
+            pz->weather[WEATHER_ICONS+j] = pz->weather[WEATHER_ICONS+j+1];
+            pz->weather[MAX_TEMPS+j] = pz->weather[MAX_TEMPS+j+1];
+            pz->weather[MIN_TEMPS+j] = pz->weather[MIN_TEMPS+j+1];
+        }
+        pz->weather[WEATHER_ICONS+MAX_WEATHER_DAYS-1] = WEATHER_UNKNOWN;
+        pz->weather[MAX_TEMPS+MAX_WEATHER_DAYS-1] = 0;
+        pz->weather[MIN_TEMPS+MAX_WEATHER_DAYS-1] = 0;
+        pz->days_rolled++;
+        changed = true;
+    }
+    return changed;
+}
+
+/*
+ * When a stored zone next needs changing: its next transition or, while it still has forecast
+ * days to drop, its next midnight
+ */
+static time_t zone_next_change(const PersistedZone *pz, time_t now) {
+    time_t next = 0;
+
+    if (pz->transition_count > 0) {
+        next = transition_time(pz->transitions);
+    }
+    if (pz->days_rolled < MAX_WEATHER_DAYS) {
+        time_t midnight = now + (SECONDS_PER_DAY - ((now + pz->gmt_sec_offset) % SECONDS_PER_DAY));
+        if ((next == 0) || (midnight < next)) {
+            next = midnight;
+        }
+    }
+    return next;
+}
+
+static void update_zones(time_t now) {
+    int count = DEFAULT_WATCH_FACES;
+
+    next_check = 0;
+    if (persist_read_int(PERSIST_VERSION_KEY) != PERSIST_VERSION) {
+        return;
+    }
+    if (persist_exists(PERSIST_ZONE_COUNT_KEY)) {
+        count = persist_read_int(PERSIST_ZONE_COUNT_KEY);
+    }
+    for (int i = 0; i < count; i++) {
+        PersistedZone pz;
+        if (persist_read_data(PERSIST_ZONE_KEY + i, &pz, sizeof(pz)) != sizeof(pz)) {
+            continue;
+        }
+        if (refresh_zone(&pz, now)) {
+            persist_write_data(PERSIST_ZONE_KEY + i, &pz, sizeof(pz));
+        }
+        time_t next = zone_next_change(&pz, now);
+        if ((next != 0) && ((next_check == 0) || (next < next_check))) {
+            next_check = next;
+        }
+    }
+}
+
+static void handle_tick(struct tm *t, TimeUnits units_changed);
+
+/*
+ * Transitions and midnights fall on whole minutes, but a zone's can fall on any minute of the
+ * hour. Hourly ticks do until the next one is less than an hour off; minute ticks then catch
+ * it on time.
+ */
+static void subscribe_ticks(time_t now) {
+    TimeUnits units = HOUR_UNIT;
+
+    if ((next_check != 0) && (next_check - now < SECONDS_PER_HOUR)) {
+        units = MINUTE_UNIT;
+    }
+    if (units != tick_units) {
+        tick_timer_service_subscribe(units, handle_tick);
+        tick_units = units;
+    }
+}
+
+/*
+ * One compare a tick; storage is only touched when something is due.
+ */
+static void handle_tick(struct tm *t, TimeUnits units_changed) {
+    time_t now = time(NULL);
+
+    if ((next_check != 0) && (now >= next_check)) {
+        update_zones(now);
+    }
+    subscribe_ticks(now);
+}
+
+static void worker_init() {
+    time_t now = time(NULL);
+
+    update_zones(now);
+    subscribe_ticks(now);
+}
+
+static void worker_deinit() {
+    tick_timer_service_unsubscribe();
+    tick_units = 0;
+}
+
+int main(void) {
+    worker_init();
+    worker_event_loop();
+    worker_deinit();
+}